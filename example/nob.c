@@ -11,15 +11,13 @@
                      "-Wl,--initial-memory=10485760", "-Wl,--allow-undefined"
 
 #define PUBLIC_DIR "public"
+#define TESTS_BUILD_DIR "tests/build"
 
 Cmd cmd = { 0 };
 Procs procs = { 0 };
 
-bool build_sandor_app(char* name)
+bool build_wasm(char* name, char* input_path, char* output_path)
 {
-    char* output_path = temp_sprintf("public/%s.wasm", name);
-    char* input_path = temp_sprintf("sandor-apps/%s.c", name);
-
     const char* input_paths[] = { input_path, "../sandor.h" };
 
     if (!needs_rebuild(output_path, input_paths, 2)) {
@@ -43,10 +41,52 @@ bool build_sandor_app(char* name)
     return true;
 }
 
+bool build_sandor_app(char* name)
+{
+    return build_wasm(name, temp_sprintf("sandor-apps/%s.c", name), temp_sprintf(PUBLIC_DIR "/%s.wasm", name));
+}
+
+bool build_sandor_test(char* name)
+{
+    return build_wasm(name, temp_sprintf("tests/%s.c", name), temp_sprintf(TESTS_BUILD_DIR "/%s.wasm", name));
+}
+
+// ./nob test builds the modules the tests load and runs them in Node
+int run_tests()
+{
+    if (!mkdir_if_not_exists(TESTS_BUILD_DIR)) {
+        nob_log(ERROR, "Could not create directory " TESTS_BUILD_DIR);
+        return 1;
+    }
+
+    if (!build_sandor_test("memo")) {
+        return 1;
+    }
+
+    if (!build_sandor_test("counter")) {
+        return 1;
+    }
+
+    if (!procs_flush(&procs)) {
+        return 1;
+    }
+
+    cmd_append(&cmd, "node", "--import", "./tests/register.mjs", "--test", "tests/*.test.mjs");
+    if (!cmd_run(&cmd)) {
+        return 1;
+    }
+
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     NOB_GO_REBUILD_URSELF(argc, argv);
 
+    if (argc > 1 && strcmp(argv[1], "test") == 0) {
+        return run_tests();
+    }
+
     if (!mkdir_if_not_exists(PUBLIC_DIR)) {
         nob_log(ERROR, "Could not create directory public");
         return 1;
@@ -28,6 +28,13 @@ uint32_t dvd_colors[] = {
 };
 static int dvd_color_index = 0;
 
+// Only the square moves: the background is filled once, afterwards only the previous square is
+// erased, so just those two regions are presented every frame
+static Olivec_Dirty dvd_dirty = {0};
+static bool dvd_background_filled = false;
+static int dvd_prev_x = 0;
+static int dvd_prev_y = 0;
+
 void dvd_change_color() {
     dvd_color_index = (dvd_color_index + 1) % (sizeof(dvd_colors) / sizeof(dvd_colors[0]));
     dvd_color = dvd_colors[dvd_color_index];
@@ -52,16 +59,23 @@ Olivec_Canvas render_dvd(float dt, uint32_t* pixels, int width, int height)
         dvd_change_color();
     }
     
-    Olivec_Canvas oc = olivec_canvas(pixels, width, height, width);
+    Olivec_Canvas oc = olivec_track_dirty(olivec_canvas(pixels, width, height, width), &dvd_dirty);
     
     // Clear background
-    olivec_fill(oc, DVD_BACKGROUND_COLOR);
+    if (!dvd_background_filled) {
+        olivec_fill(oc, DVD_BACKGROUND_COLOR);
+        dvd_background_filled = true;
+    } else {
+        olivec_rect(oc, dvd_prev_x, dvd_prev_y, DVD_SQUARE_SIZE, DVD_SQUARE_SIZE, DVD_BACKGROUND_COLOR);
+    }
     
     // Draw simple colored square
     int square_x = (int)dvd_x;
     int square_y = (int)dvd_y;
     
     olivec_rect(oc, square_x, square_y, DVD_SQUARE_SIZE, DVD_SQUARE_SIZE, dvd_color);
+    dvd_prev_x = square_x;
+    dvd_prev_y = square_y;
     
     return oc;
 }
@@ -3,6 +3,7 @@
 #include "cube.h"
 
 typedef struct {
+    // Always a string literal
     char* title;
     char* background_class;
     Element* content;
@@ -11,9 +12,10 @@ typedef struct {
 // Example component
 int click_count = 0;
 
-void example_component_click(void* args) {
+bool example_component_click(void* args) {
     ASSERT(args == NULL);
     click_count++;
+    return true;
 }
 
 Element* render_example_component() {
@@ -54,9 +56,9 @@ Slide get_slide(size_t slide_index) {
             return (Slide) {
                 .title = "🚁 sandor.h",
                 .background_class = "bg-base-200",
-                .content = class(
+                .content = class_static(
                     element("div", children(
-                        text_element("p", "Write web UIs in C")
+                        text_static("p", "Write web UIs in C")
                     )),
                     TEXT_SLIDE_CLASSES
                 )
@@ -66,12 +68,12 @@ Slide get_slide(size_t slide_index) {
             return (Slide) {
                 .title = "What is sandor.h?",
                 .background_class = "bg-base-200",
-                .content = class(
+                .content = class_static(
                     element("div", children(
-                        class(element("ul", children(
-                            text_element("li", "Single-header* library for web UIs in C"),
-                            text_element("li", "Recreational programming project"),
-                            text_element("li", "Powers this presentation")
+                        class_static(element("ul", children(
+                            text_static("li", "Single-header* library for web UIs in C"),
+                            text_static("li", "Recreational programming project"),
+                            text_static("li", "Powers this presentation")
                         )), "list-disc list-inside text-left")
                     )),
                     TEXT_SLIDE_CLASSES
@@ -82,9 +84,9 @@ Slide get_slide(size_t slide_index) {
             return (Slide) {
                 .title = "🏗️ Architecture",
                 .background_class = "bg-base-200",
-                .content = class(
+                .content = class_static(
                     element("div", children(
-                        text_element("pre", 
+                        text_static("pre", 
                             "┌─────────────────┐    ┌─────────────────┐    ┌─────────────────┐\n"
                             "│   C Application │    │      clang      │    │   WebAssembly   │\n"
                             "│   + sandor.h    │────│       +         │────│     (.wasm)     │\n"
@@ -112,20 +114,21 @@ Slide get_slide(size_t slide_index) {
             return (Slide) {
                 .title = "💻 Example component",
                 .background_class = "bg-base-200",
-                .content = class(
+                .content = class_static(
                     element("div", children(
                         // Code example
-                        class(
+                        class_static(
                             element("div", children(
-                                class(text_element("h2", "Code"), "text-xl font-bold mb-4"),
+                                class_static(text_static("h2", "Code"), "text-xl font-bold mb-4"),
                                 // This should always reflect the actual code in the example component, except for the function name as that should be render_component for the example to be valid
-                                text_element("pre", "#include \"sandor.h\"\n"
+                                text_static("pre", "#include \"sandor.h\"\n"
                                                    "\n"
                                                    "int click_count = 0;\n"
                                                    "\n"
-                                                   "void example_component_click(void* args) {\n"
+                                                   "bool example_component_click(void* args) {\n"
                                                    "    ASSERT(args == NULL);\n"
                                                    "    click_count++;\n"
+                                                   "    return true;\n"
                                                    "}\n"
                                                    "\n"
                                                    "Element* render_component() {\n"
@@ -143,7 +146,7 @@ Slide get_slide(size_t slide_index) {
                             "text-sm flex-1 " CODE_SLIDE_CLASSES
                         ),
                         // Interactive example
-                        class(
+                        class_static(
                             element("div", children(
                                 render_example_component()
                             )),
@@ -158,12 +161,12 @@ Slide get_slide(size_t slide_index) {
             return (Slide) {
                 .title = "🎨 Canvas example",
                 .background_class = "bg-base-200",
-                .content = class(
+                .content = class_static(
                     element("div", children(
-                        class(
+                        class_static(
                             element("div", children(
-                                class(text_element("h2", "Code"), "text-xl font-bold mb-4"),
-                                text_element("pre", "#include \"sandor.h\"\n"
+                                class_static(text_static("h2", "Code"), "text-xl font-bold mb-4"),
+                                text_static("pre", "#include \"sandor.h\"\n"
                                                    "#include \"cube.h\"\n"
                                                    "\n"
                                                    "#define WIDTH 400\n"
@@ -190,7 +193,7 @@ Slide get_slide(size_t slide_index) {
                             )),
                             "text-sm flex-1 " CODE_SLIDE_CLASSES
                         ),
-                        class(
+                        class_static(
                             element("div", children(
                                 attributes(
                                     element("canvas", NULL),
@@ -209,13 +212,13 @@ Slide get_slide(size_t slide_index) {
             return (Slide) {
                 .title = "What's next?",
                 .background_class = "bg-base-200",
-                .content = class(
+                .content = class_static(
                     element("div", children(
-                        class(element("ul", children(
-                            text_element("li", "⌨️ Keyboard events"),
-                            text_element("li", "📦 Actually single-header"),
-                            text_element("li", "🔌 Standalone TS bridge"),
-                            text_element("li", "🚁 Continue having fun programming")
+                        class_static(element("ul", children(
+                            text_static("li", "⌨️ Keyboard events"),
+                            text_static("li", "📦 Actually single-header"),
+                            text_static("li", "🔌 Standalone TS bridge"),
+                            text_static("li", "🚁 Continue having fun programming")
                         )), "list-none text-left")
                     )),
                     TEXT_SLIDE_CLASSES
@@ -226,12 +229,12 @@ Slide get_slide(size_t slide_index) {
             return (Slide) {
                 .title = "Thanks!",
                 .background_class = "bg-success",
-                .content = class(
+                .content = class_static(
                     element("div", children(
-                        text_element("p", "Any questions?"),
-                        class(
+                        text_static("p", "Any questions?"),
+                        class_static(
                             element("a", children(
-                                text_element("span", "github.com/matemolnar8/sandor")
+                                text_static("span", "github.com/matemolnar8/sandor")
                             )),
                             "link"
                         )
@@ -244,7 +247,7 @@ Slide get_slide(size_t slide_index) {
             return (Slide) {
                 .title = "Unknown Slide",
                 .background_class = "bg-base-200",
-                .content = text_element("p", "Slide not found")
+                .content = text_static("p", "Slide not found")
             };
     }
 }
@@ -252,42 +255,52 @@ Slide get_slide(size_t slide_index) {
 #define SLIDE_COUNT 7
 size_t current_slide = 0;
 
-void next_slide(void* args) {
+bool next_slide(void* args) {
     ASSERT(args == NULL);
     if (current_slide < SLIDE_COUNT - 1) {
         current_slide++;
+        return true;
     }
+    return false;
 }
 
-void prev_slide(void* args) {
+bool prev_slide(void* args) {
     ASSERT(args == NULL);
     if (current_slide > 0) {
         current_slide--;
+        return true;
     }
+    return false;
 }
 
-void goto_first_slide(void* args) {
+bool goto_first_slide(void* args) {
     ASSERT(args == NULL);
+    bool changed = current_slide != 0;
     current_slide = 0;
+    return changed;
 }
 
-void goto_last_slide(void* args) {
+bool goto_last_slide(void* args) {
     ASSERT(args == NULL);
+    bool changed = current_slide != SLIDE_COUNT - 1;
     current_slide = SLIDE_COUNT - 1;
+    return changed;
 }
 
-Element* slide_navigation() {
+// Only depends on current_slide, so it is memoized and left alone while a slide is animating
+Element* render_slide_navigation(const void* deps) {
+    (void)deps;
     char* slide_counter = arena_sprintf(&r_arena, "%zu / %d", current_slide + 1, SLIDE_COUNT);
     
-    return class(
+    return class_static(
         element("div", children(
-            class(
+            class_static(
                 element("div", children(
-                    class(button("⏮", goto_first_slide, NULL), current_slide == 0 ? "btn btn-circle btn-disabled" : "btn btn-circle btn-primary"),
-                    class(button("◀", prev_slide, NULL), current_slide == 0 ? "btn btn-circle btn-disabled" : "btn btn-circle btn-secondary"),
-                    class(text_element("span", slide_counter), "mx-6 text-lg font-bold badge badge-neutral badge-lg"),
-                    class(button("▶", next_slide, NULL), current_slide >= SLIDE_COUNT - 1 ? "btn btn-circle btn-disabled" : "btn btn-circle btn-secondary"),
-                    class(button("⏭", goto_last_slide, NULL), current_slide >= SLIDE_COUNT - 1 ? "btn btn-circle btn-disabled" : "btn btn-circle btn-primary")
+                    class_static(button("⏮", goto_first_slide, NULL), current_slide == 0 ? "btn btn-circle btn-disabled" : "btn btn-circle btn-primary"),
+                    class_static(button("◀", prev_slide, NULL), current_slide == 0 ? "btn btn-circle btn-disabled" : "btn btn-circle btn-secondary"),
+                    class_static(text_element("span", slide_counter), "mx-6 text-lg font-bold badge badge-neutral badge-lg"),
+                    class_static(button("▶", next_slide, NULL), current_slide >= SLIDE_COUNT - 1 ? "btn btn-circle btn-disabled" : "btn btn-circle btn-secondary"),
+                    class_static(button("⏭", goto_last_slide, NULL), current_slide >= SLIDE_COUNT - 1 ? "btn btn-circle btn-disabled" : "btn btn-circle btn-primary")
                 )),
                 "flex items-center justify-center gap-3"
             )
@@ -301,10 +314,10 @@ Element* slide_content(Slide slide) {
         current_slide = 0;
     }
     
-    return class(
+    return class_static(
         element("div", children(
-            class(
-                text_element("h1", slide.title), 
+            class_static(
+                text_static("h1", slide.title), 
                 "text-7xl font-black mb-12 text-center rounded-lg shadow-lg bg-base-100 p-6"
             ),
             slide.content
@@ -327,7 +340,7 @@ Element* render_component() {
     return class(
         element("div", children(
             slide_content(slide),
-            slide_navigation()
+            memo("slide-navigation", &current_slide, sizeof(current_slide), render_slide_navigation)
         )),
         arena_sprintf(&r_arena, "h-full w-full flex flex-col transition-all duration-500 ease-in-out %s", slide.background_class)
     );
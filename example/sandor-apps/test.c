@@ -3,9 +3,10 @@
 int render_count = 0;
 int count = 0;
 
-void button_callback(void* args) {
+bool button_callback(void* args) {
     ASSERT(args == NULL);
     count++;
+    return true;
 }
 
 Element* render_component()
@@ -16,25 +16,33 @@ Todos todos = {0};
 Arena todo_list_arena = {0};
 
 bool has_error = false;
-char input_text[INPUT_BUFFER_CAPACITY] = "\0";
-void on_change(const char* text) {
-    copy(text, input_text, INPUT_BUFFER_CAPACITY);
-
-    if (input_text[0] == '\0') {
+#define TODO_TEXT_CAPACITY 4096
+char input_text[TODO_TEXT_CAPACITY] = "\0";
+bool on_change(const char* text) {
+    bool had_error = has_error;
+
+    // Inputs can be longer than the buffer of a todo, those are rejected like empty ones
+    if (arena_strlen(text) >= TODO_TEXT_CAPACITY) {
+        *input_text = '\0';
         has_error = true;
-    } else {
-        has_error = false;
+        return has_error != had_error;
     }
-    platform_rerender();
+
+    copy(text, input_text, TODO_TEXT_CAPACITY);
+
+    // Typing needs no render, the input already shows the text it renders as its value
+    has_error = input_text[0] == '\0';
+    return has_error != had_error;
 }
 
-void add_todo(void* args)
+bool add_todo(void* args)
 {
     ASSERT(args == NULL);
 
     if(input_text[0] == '\0') {
+        bool had_error = has_error;
         has_error = true;
-        return;
+        return !had_error;
     }
 
     Todo* todo = arena_alloc(&todo_list_arena, sizeof(Todo));
@@ -46,43 +54,61 @@ void add_todo(void* args)
     *input_text = '\0';
     
     arena_da_append(&todo_list_arena, &todos, todo);
+    return true;
 }
 
-typedef struct {
-    size_t index;
-} ToggleTodoArgs;
+// Keeps the text up to date while typing, change only fires once the input loses focus
+bool on_input(const Event* event, void* args) {
+    ASSERT(args == NULL);
+    return on_change(event->value);
+}
 
-void toggle_todo(void* args) {
-    ASSERT(args != NULL);
+bool on_keydown(const Event* event, void* args) {
+    ASSERT(args == NULL);
 
-    ToggleTodoArgs* toggle_todo_args = (ToggleTodoArgs*)args;
-    todos.items[toggle_todo_args->index]->completed = !todos.items[toggle_todo_args->index]->completed;
+    if (!str_eq(event->value, "Enter")) {
+        return false;
+    }
+    return add_todo(NULL);
 }
 
-Element* todo_list() {
-    Element* todo_list = element("ul", children_empty());
+bool toggle_todo(void* args) {
+    ASSERT(args != NULL);
+
+    Todo* todo = args;
+    todo->completed = !todo->completed;
+    return true;
+}
 
-    for (size_t i = 0; i < todos.count; i++) {
-        ToggleTodoArgs* toggle_todo_args = arena_alloc(&r_arena, sizeof(ToggleTodoArgs));
-        toggle_todo_args->index = i;
+#define TODO_ROW_HEIGHT 48
 
-        Todo* todo = todos.items[i];
-        Element* li_item = element("li", children(
+Element* todo_row(size_t index) {
+    Todo* todo = todos.items[index];
+    return class_static(
+        element("div", children(
             text_element("span", arena_sprintf(&r_arena, "%s: %s", todo->text, todo->completed ? "✅" : "❌")),
-            class(button("Toggle", toggle_todo, toggle_todo_args), "btn ml-2")
-        ));
-        add_children(todo_list, li_item);
-    }
+            class_static(button("Toggle", toggle_todo, todo), "btn ml-2")
+        )),
+        "flex items-center h-full"
+    );
+}
 
-    return todo_list;
+// Only the rows scrolled into view are rendered, however long the list gets
+Element* todo_list() {
+    return class_static(
+        virtual_list(todos.count, TODO_ROW_HEIGHT, todo_row),
+        "w-full max-w-md flex-1 min-h-0"
+    );
 }
 
 Element* render_component()
 {
     Element* input_element = attributes(
-        input("Enter a new todo", on_change),
+        value(input("Enter a new todo", on_change), input_text),
         "class", has_error ? "input input-error" : "input"
     );
+    on(input_element, EVENT_INPUT, on_input, NULL);
+    on(input_element, EVENT_KEYDOWN, on_keydown, NULL);
 
     return class(
         element("div", children(
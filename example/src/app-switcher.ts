@@ -1,6 +1,9 @@
-const apps = [
+import type { Execution } from "./wasm-shell-component";
+
+// The canvas app draws every frame, it runs in a worker so that it does not block the page
+const apps: { value: string; label: string; execution?: Execution }[] = [
   { value: "presentation", label: "Presentation" },
-  { value: "canvas", label: "Canvas" },
+  { value: "canvas", label: "Canvas", execution: "worker" },
   { value: "test", label: "Test" },
   { value: "todolist", label: "Todolist" },
 ];
@@ -8,6 +11,10 @@ const apps = [
 function createApp(name: string) {
   const app = document.createElement("wasm-shell-component");
   app.setAttribute("name", name);
+  const execution = apps.find((app) => app.value === name)?.execution;
+  if (execution) {
+    app.setAttribute("execution", execution);
+  }
   app.className = "w-full h-full";
   return app;
 }
@@ -0,0 +1,61 @@
+// 2D context of a canvas element on the main thread, or of an OffscreenCanvas in a worker
+export type CanvasContext = CanvasRenderingContext2D | OffscreenCanvasRenderingContext2D;
+
+// Copies the width * height pixels of rows that are stride pixels apart into a tightly packed buffer
+export function packPixels(pixels: Uint8ClampedArray, width: number, height: number, stride: number) {
+  if (stride === width) {
+    return pixels.slice(0, width * height * 4);
+  }
+
+  const packed = new Uint8ClampedArray(width * height * 4);
+  for (let y = 0; y < height; y++) {
+    packed.set(pixels.subarray(y * stride * 4, (y * stride + width) * 4), y * width * 4);
+  }
+  return packed;
+}
+
+// Puts the pixels of a sandor canvas into a 2D context. The ImageData of the last blit wraps its
+// pixels without copying them, it is reused while the same pixels are drawn.
+export class CanvasPresenter {
+  context: CanvasContext;
+  imageData: ImageData | undefined;
+  // Set once the canvas got all of its pixels, afterwards only the regions that changed are drawn.
+  // Resizing a canvas clears it, it gets all of its pixels again.
+  presented = false;
+  presentedWidth = 0;
+  presentedHeight = 0;
+
+  constructor(context: CanvasContext) {
+    this.context = context;
+  }
+
+  resize(width: number, height: number) {
+    const canvas = this.context.canvas;
+    if (canvas.width !== width || canvas.height !== height) {
+      canvas.width = width;
+      canvas.height = height;
+    }
+  }
+
+  // Draws width * height RGBA pixels out of height rows that are stride pixels long, the rest of
+  // every row is left out. pixels can be a view of wasm memory, it is read by this call and the next
+  // ones with the same view. dirty limits the drawing to its regions, as x, y, width and height each.
+  present(pixels: Uint8ClampedArray, width: number, height: number, stride: number, dirty?: Int32Array) {
+    if (this.imageData?.data !== pixels) {
+      this.imageData = new ImageData(pixels, stride);
+    }
+
+    const canvas = this.context.canvas;
+    if (!dirty || !this.presented || canvas.width !== this.presentedWidth || canvas.height !== this.presentedHeight) {
+      this.context.putImageData(this.imageData, 0, 0, 0, 0, width, height);
+      this.presented = true;
+      this.presentedWidth = canvas.width;
+      this.presentedHeight = canvas.height;
+      return;
+    }
+
+    for (let i = 0; i + 3 < dirty.length; i += 4) {
+      this.context.putImageData(this.imageData, 0, 0, dirty[i], dirty[i + 1], dirty[i + 2], dirty[i + 3]);
+    }
+  }
+}
@@ -0,0 +1,605 @@
+import { CanvasPresenter } from "./canvas-presenter";
+import { assertAndGet } from "./util/assert-value";
+
+// Element type constants matching C enum
+const ElementType = {
+  GENERIC: 0,
+  BUTTON: 1,
+  INPUT: 2,
+  CANVAS: 3,
+  VIRTUAL_LIST: 4,
+} as const;
+
+// Render command opcodes matching C RenderOp enum
+const RenderOp = {
+  OPEN: 1,
+  ATTRIBUTE: 2,
+  TEXT: 3,
+  CLOSE: 4,
+  MOVE: 5,
+  REMOVE: 6,
+  SET_TEXT: 7,
+  SET_ATTRIBUTE: 8,
+  REMOVE_ATTRIBUTE: 9,
+  SET_INDEX: 10,
+  SET_WINDOW: 11,
+} as const;
+
+// Bubbling events delegated to wasm by the root listeners, the position is the C EventType
+const delegatedEvents = [
+  "click",
+  "change",
+  "input",
+  "keydown",
+  "keyup",
+  "pointerdown",
+  "pointermove",
+  "pointerup",
+  "wheel",
+] as const;
+
+// Pixels per line and per page of wheel events that are not measured in pixels
+const WHEEL_LINE_HEIGHT = 16;
+const WHEEL_PAGE_HEIGHT = 800;
+
+// Modifier bits matching C MODIFIER_*
+const Modifier = {
+  SHIFT: 1,
+  CTRL: 2,
+  ALT: 4,
+  META: 8,
+} as const;
+
+// Node id of the component root, matching C ROOT_NODE
+const ROOT_NODE = 0;
+
+// Set on the id of a string ref when the string itself follows, matching C STRING_REF_DEFINE
+const STRING_REF_DEFINE = 0x80000000;
+
+declare global {
+  interface Window {
+    sandor?: {
+      debug?: boolean;
+    };
+  }
+}
+
+// A DOM event bubbled from its target up to the root, with every node on the way that handles it
+// in C, innermost first. Plain data, so it can be posted to a worker.
+export type DelegatedEvent = {
+  type: number;
+  value: string | undefined;
+  modifiers: number;
+  // Scroll amount of wheel events in pixels, 0 otherwise
+  deltaX: number;
+  deltaY: number;
+  targets: { index: number; x: number; y: number }[];
+};
+
+// Where the patcher sends what happens on its nodes, the wasm runtime directly or a worker
+export type DomPatcherHost = {
+  dispatchEvent(event: DelegatedEvent): void;
+  scroll(index: number, scrollTop: number, viewportHeight: number): void;
+  render(): void;
+  // Hosts that present canvases themselves get control of every canvas node as it is created, and
+  // are told when it is gone
+  attachCanvas?(canvasId: string, node: number, canvas: OffscreenCanvas): void;
+  // The size of a transferred canvas belongs to its OffscreenCanvas, id and size changes go there
+  updateCanvas?(canvasId: string, node: number, width: number, height: number): void;
+  detachCanvas?(canvasId: string, node: number): void;
+  // Visibility of a canvas, or of the whole document without canvasId. Animations that only present
+  // canvases that are not visible are paused.
+  setVisible(visible: boolean, canvasId?: string): void;
+};
+
+// A canvas element and what draws into it, nothing on this side once its control was transferred
+// to the host
+type CanvasTarget = {
+  element: HTMLCanvasElement;
+  presenter: CanvasPresenter | undefined;
+};
+
+// Owns the live nodes of a component and applies the render commands and canvas pixels of its
+// wasm runtime to them. It never touches wasm memory, so the runtime can live in a worker.
+export class DomPatcher {
+  parent: HTMLElement;
+  host: DomPatcherHost;
+  instanceId: string;
+
+  // Live host nodes by the node ids assigned in C
+  nodes = new Map<number, HTMLElement>();
+  nodeIds = new WeakMap<Element, number>();
+  // Decoded interned strings by their id in C, every one of them is only sent and decoded once
+  internedStrings: string[] = [];
+  rootElement: HTMLElement | undefined;
+  // Reports viewport size changes of virtual lists, including their first layout
+  resizeObserver = new ResizeObserver((entries) => {
+    for (const entry of entries) {
+      const node = this.nodeIds.get(entry.target);
+      if (node !== undefined && this.nodes.has(node)) {
+        this.reportScroll(entry.target as HTMLElement);
+      }
+    }
+  });
+  // Reports canvases scrolling in and out of view, including their first layout
+  intersectionObserver = new IntersectionObserver((entries) => {
+    for (const entry of entries) {
+      const node = this.nodeIds.get(entry.target);
+      if (node !== undefined && this.nodes.has(node)) {
+        this.host.setVisible(entry.isIntersecting, entry.target.id);
+      }
+    }
+  });
+  reportDocumentVisibility = () => {
+    this.host.setVisible(document.visibilityState === "visible");
+  };
+  debugRerenderButton: HTMLElement | undefined;
+  // Canvases by their id, looked up once
+  canvases = new Map<string, CanvasTarget>();
+
+  constructor(parent: HTMLElement, host: DomPatcherHost, instanceId: string) {
+    this.parent = parent;
+    this.host = host;
+    this.instanceId = instanceId;
+  }
+
+  destroy() {
+    this.rootElement?.remove();
+    this.debugRerenderButton?.remove();
+    this.rootElement = undefined;
+    this.debugRerenderButton = undefined;
+    this.nodes.clear();
+    this.canvases.clear();
+    this.internedStrings = [];
+    this.resizeObserver.disconnect();
+    this.intersectionObserver.disconnect();
+    document.removeEventListener("visibilitychange", this.reportDocumentVisibility);
+  }
+
+  // The root is created with the first render, it carries the delegated event listeners
+  mount() {
+    if (this.rootElement) {
+      return;
+    }
+
+    const rootElement = document.createElement("div");
+    rootElement.setAttribute("data-instance-id", this.instanceId);
+    rootElement.setAttribute("class", "h-full flex flex-col");
+    this.nodes.set(ROOT_NODE, rootElement);
+    this.parent.appendChild(rootElement);
+    this.rootElement = rootElement;
+
+    delegatedEvents.forEach((name, eventType) => {
+      rootElement.addEventListener(name, (event) => this.delegateEvent(eventType, event), { passive: true });
+    });
+
+    document.addEventListener("visibilitychange", this.reportDocumentVisibility);
+    this.reportDocumentVisibility();
+
+    if (window.sandor?.debug) {
+      this.debugRerenderButton = document.createElement("button");
+      this.debugRerenderButton.classList.add("btn", "rounded-full");
+      this.debugRerenderButton.textContent = "Debug rerender";
+      this.debugRerenderButton.addEventListener("click", () => {
+        this.host.render();
+      });
+      this.parent.appendChild(this.debugRerenderButton);
+    }
+  }
+
+  // Applies the patch commands produced by the diff in sandor.h to the live nodes in a single pass
+  // The commands are bytes[start, end), strings is the string pool of the same render
+  applyRenderCommands(bytes: Uint8Array, start: number, end: number, strings: string[]) {
+    this.mount();
+
+    let offset = start;
+    const readU8 = () => bytes[offset++];
+    const readU32 = () => {
+      const value =
+        (bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) | (bytes[offset + 3] << 24)) >>> 0;
+      offset += 4;
+      return value;
+    };
+    const readStr = () => assertAndGet(strings[readU32()], "String index out of range");
+    const readRef = () => {
+      const ref = readU32();
+      if (ref === 0) {
+        return readStr();
+      }
+      if (ref & STRING_REF_DEFINE) {
+        const value = readStr();
+        this.internedStrings[ref & ~STRING_REF_DEFINE] = value;
+        return value;
+      }
+      return assertAndGet(this.internedStrings[ref], `Unknown interned string ${ref}`);
+    };
+
+    // Subtrees created by OPEN ... CLOSE are built detached and placed with MOVE afterwards
+    const stack: HTMLElement[] = [];
+    // Removed nodes are forgotten at the end, memoized subtrees may still be moved out of them
+    const removed: HTMLElement[] = [];
+    const top = () => assertAndGet(stack[stack.length - 1], "Command outside of element");
+
+    while (offset < end) {
+      const op = readU8();
+      switch (op) {
+        case RenderOp.OPEN: {
+          const node = readU32();
+          const elementType = readU8();
+          const index = readU32();
+          const events = readU32();
+          const element = this.createElement(node, elementType, readU32, readStr, readRef);
+          if (events !== 0 || elementType === ElementType.VIRTUAL_LIST) {
+            this.setElementIndex(element, index, events);
+          }
+          stack[stack.length - 1]?.appendChild(element);
+          stack.push(element);
+          break;
+        }
+
+        case RenderOp.ATTRIBUTE: {
+          const element = top();
+          const name = readRef();
+          element.setAttribute(name, readRef());
+          break;
+        }
+
+        case RenderOp.TEXT:
+          this.setText(top(), readStr());
+          break;
+
+        case RenderOp.CLOSE:
+          assertAndGet(stack.pop(), "Unbalanced close command");
+          break;
+
+        case RenderOp.MOVE: {
+          const parent = this.getNode(readU32());
+          const node = this.getNode(readU32());
+          const before = readU32();
+          parent.insertBefore(node, before === 0 ? null : this.getNode(before));
+          break;
+        }
+
+        case RenderOp.REMOVE:
+          removed.push(this.removeNode(readU32()));
+          break;
+
+        case RenderOp.SET_TEXT: {
+          const node = this.getNode(readU32());
+          this.setText(node, readStr());
+          break;
+        }
+
+        case RenderOp.SET_ATTRIBUTE: {
+          const node = readU32();
+          const element = this.getNode(node);
+          const name = readRef();
+          const value = readRef();
+          if (element instanceof HTMLCanvasElement) {
+            this.setCanvasAttribute(node, element, name, value);
+          } else {
+            element.setAttribute(name, value);
+          }
+          break;
+        }
+
+        case RenderOp.REMOVE_ATTRIBUTE: {
+          const node = this.getNode(readU32());
+          node.removeAttribute(readRef());
+          break;
+        }
+
+        case RenderOp.SET_INDEX: {
+          const node = this.getNode(readU32());
+          const index = readU32();
+          this.setElementIndex(node, index, readU32());
+          break;
+        }
+
+        case RenderOp.SET_WINDOW:
+          this.setWindow(this.getNode(readU32()), readU32(), readU32(), readU32(), readU32());
+          break;
+
+        default:
+          throw new Error(`Unknown render op: ${op}`);
+      }
+    }
+
+    if (stack.length !== 0) {
+      throw new Error("Unbalanced render commands");
+    }
+
+    for (const element of removed) {
+      this.forgetSubtree(element);
+    }
+  }
+
+  // Draws RGBA pixels of width * height into the canvas with canvasId, see CanvasPresenter.present.
+  // Pixels for a canvas the host presents itself are dropped, they were sent before the host got
+  // control of it.
+  drawCanvas(
+    canvasId: string,
+    pixels: Uint8ClampedArray,
+    width: number,
+    height: number,
+    stride: number,
+    dirty?: Int32Array
+  ) {
+    this.getCanvas(canvasId)?.presenter?.present(pixels, width, height, stride, dirty);
+  }
+
+  // Canvases are looked up and observed by id, and a transferred one has to be resized by its host
+  setCanvasAttribute(node: number, canvas: HTMLCanvasElement, name: string, value: string) {
+    const oldId = canvas.id;
+    canvas.setAttribute(name, value);
+    if (name !== "id" && name !== "width" && name !== "height") {
+      return;
+    }
+
+    if (name === "id") {
+      // Observed again, the new id gets its own first report
+      this.host.setVisible(false, oldId);
+      this.intersectionObserver.unobserve(canvas);
+      this.intersectionObserver.observe(canvas);
+
+      const renamed = this.canvases.get(oldId);
+      if (renamed?.element === canvas) {
+        this.canvases.delete(oldId);
+        this.canvases.set(canvas.id, renamed);
+      }
+    }
+
+    // Transferred to the host, which presents it itself
+    const target = this.canvases.get(canvas.id);
+    if (target?.element === canvas && target.presenter === undefined) {
+      const width = Number(canvas.getAttribute("width"));
+      this.host.updateCanvas?.(canvas.id, node, width, Number(canvas.getAttribute("height")));
+    }
+  }
+
+  getCanvas(canvasId: string) {
+    const cached = this.canvases.get(canvasId);
+    // A canvas that was removed and created again with the same id is looked up again
+    if (cached && cached.element.isConnected) {
+      return cached;
+    }
+    this.canvases.delete(canvasId);
+
+    const element = this.rootElement?.querySelector(`#${canvasId}`);
+    if (!(element instanceof HTMLCanvasElement)) {
+      console.error("Canvas element not found");
+      return undefined;
+    }
+    const context = element.getContext("2d");
+    if (!context) {
+      console.error("Failed to get canvas context");
+      return undefined;
+    }
+
+    const canvas: CanvasTarget = { element, presenter: new CanvasPresenter(context) };
+    this.canvases.set(canvasId, canvas);
+    return canvas;
+  }
+
+  createElement(
+    node: number,
+    elementType: number,
+    readU32: () => number,
+    readStr: () => string,
+    readRef: () => string
+  ): HTMLElement {
+    let element: HTMLElement;
+
+    switch (elementType) {
+      case ElementType.GENERIC:
+        element = document.createElement(readRef());
+        break;
+
+      case ElementType.BUTTON:
+        element = document.createElement("button");
+        break;
+
+      case ElementType.INPUT:
+        element = document.createElement("input");
+        element.setAttribute("type", "text");
+        element.setAttribute("placeholder", readStr());
+        break;
+
+      case ElementType.CANVAS: {
+        const canvas = document.createElement("canvas");
+        canvas.id = readStr();
+        canvas.setAttribute("width", readU32().toString());
+        canvas.setAttribute("height", readU32().toString());
+        // The size has to be set before, it belongs to the OffscreenCanvas afterwards
+        if (this.host.attachCanvas && typeof canvas.transferControlToOffscreen === "function") {
+          this.host.attachCanvas(canvas.id, node, canvas.transferControlToOffscreen());
+          this.canvases.set(canvas.id, { element: canvas, presenter: undefined });
+        }
+        this.intersectionObserver.observe(canvas);
+        element = canvas;
+        break;
+      }
+
+      case ElementType.VIRTUAL_LIST: {
+        const list = document.createElement("div");
+        list.style.overflowY = "auto";
+        // Rows are swapped at the edges while scrolling, scroll anchoring must not compensate for that
+        list.style.overflowAnchor = "none";
+        this.setWindow(list, readU32(), readU32(), readU32(), readU32());
+        // Scroll events do not bubble, so they cannot be delegated
+        list.addEventListener("scroll", () => this.reportScroll(list), { passive: true });
+        this.resizeObserver.observe(list);
+        element = list;
+        break;
+      }
+
+      default:
+        throw new Error(`Unknown element type: ${elementType}`);
+    }
+
+    this.nodes.set(node, element);
+    this.nodeIds.set(element, node);
+
+    return element;
+  }
+
+  getNode(node: number) {
+    return assertAndGet(this.nodes.get(node), `Node ${node} not found`);
+  }
+
+  // Interactive nodes carry their current element index and the mask of events C handles for them
+  setElementIndex(element: HTMLElement, index: number, events: number) {
+    element.dataset.sandorIndex = index.toString();
+    if (events !== 0) {
+      element.dataset.sandorEvents = events.toString();
+    } else {
+      delete element.dataset.sandorEvents;
+    }
+  }
+
+  getElementIndex(element: HTMLElement) {
+    return Number(assertAndGet(element.dataset.sandorIndex, "Element index not found"));
+  }
+
+  // Collects the nodes between the target of the event and the root that handle it, and hands them
+  // to the host in a single call
+  delegateEvent(eventType: number, event: Event) {
+    const mask = 1 << eventType;
+    const targets: DelegatedEvent["targets"] = [];
+
+    let target = event.target instanceof HTMLElement ? event.target : null;
+    for (; target && target !== this.rootElement; target = target.parentElement) {
+      const events = target.dataset.sandorEvents;
+      if (events === undefined || (Number(events) & mask) === 0) {
+        continue;
+      }
+
+      let x = 0;
+      let y = 0;
+      if (event instanceof MouseEvent) {
+        const rect = target.getBoundingClientRect();
+        x = Math.round(event.clientX - rect.left);
+        y = Math.round(event.clientY - rect.top);
+      }
+
+      targets.push({ index: this.getElementIndex(target), x, y });
+    }
+
+    if (targets.length === 0) {
+      return;
+    }
+
+    const [deltaX, deltaY] = this.wheelDelta(event);
+    this.host.dispatchEvent({
+      type: eventType,
+      value: this.eventValue(event),
+      modifiers: this.eventModifiers(event),
+      deltaX,
+      deltaY,
+      targets,
+    });
+  }
+
+  wheelDelta(event: Event) {
+    if (!(event instanceof WheelEvent)) {
+      return [0, 0];
+    }
+
+    let scale = 1;
+    if (event.deltaMode === WheelEvent.DOM_DELTA_LINE) {
+      scale = WHEEL_LINE_HEIGHT;
+    } else if (event.deltaMode === WheelEvent.DOM_DELTA_PAGE) {
+      scale = WHEEL_PAGE_HEIGHT;
+    }
+    return [Math.round(event.deltaX * scale), Math.round(event.deltaY * scale)];
+  }
+
+  eventModifiers(event: Event) {
+    if (!(event instanceof MouseEvent || event instanceof KeyboardEvent)) {
+      return 0;
+    }
+
+    return (
+      (event.shiftKey ? Modifier.SHIFT : 0) |
+      (event.ctrlKey ? Modifier.CTRL : 0) |
+      (event.altKey ? Modifier.ALT : 0) |
+      (event.metaKey ? Modifier.META : 0)
+    );
+  }
+
+  eventValue(event: Event) {
+    if (event instanceof KeyboardEvent) {
+      return event.key;
+    }
+    if ((event.type === "change" || event.type === "input") && event.target instanceof HTMLInputElement) {
+      return event.target.value;
+    }
+    return undefined;
+  }
+
+  removeNode(node: number) {
+    const element = this.getNode(node);
+    element.remove();
+    return element;
+  }
+
+  // The whole subtree is gone, C only reports its root
+  forgetSubtree(element: HTMLElement) {
+    if (element.parentNode !== null) {
+      return;
+    }
+
+    this.forgetNode(element);
+    for (const descendant of element.querySelectorAll("*")) {
+      this.forgetNode(descendant);
+    }
+  }
+
+  forgetNode(element: Element) {
+    const node = this.nodeIds.get(element);
+    if (node !== undefined) {
+      this.nodes.delete(node);
+      this.resizeObserver.unobserve(element);
+
+      if (element instanceof HTMLCanvasElement) {
+        this.intersectionObserver.unobserve(element);
+        // A canvas created in its place with the same id reports itself visible after this
+        this.host.setVisible(false, element.id);
+
+        if (this.canvases.get(element.id)?.element === element) {
+          this.canvases.delete(element.id);
+          this.host.detachCanvas?.(element.id, node);
+        }
+      }
+    }
+  }
+
+  // Only rows [first, last) are rendered, the padding stands in for the rest
+  setWindow(element: HTMLElement, count: number, rowHeight: number, first: number, last: number) {
+    element.style.paddingTop = `${first * rowHeight}px`;
+    element.style.paddingBottom = `${(count - last) * rowHeight}px`;
+  }
+
+  reportScroll(element: HTMLElement) {
+    this.host.scroll(this.getElementIndex(element), Math.max(0, Math.round(element.scrollTop)), element.clientHeight);
+  }
+
+  // Text lives in a leading text node so it can be updated without touching the children
+  setText(element: HTMLElement, text: string) {
+    if (element instanceof HTMLInputElement) {
+      element.value = text;
+      return;
+    }
+
+    const first = element.firstChild;
+    if (first instanceof Text) {
+      if (text) {
+        first.data = text;
+      } else {
+        first.remove();
+      }
+    } else if (text) {
+      element.insertBefore(document.createTextNode(text), first);
+    }
+  }
+}
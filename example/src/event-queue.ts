@@ -0,0 +1,86 @@
+import type { DelegatedEvent } from "./dom-patcher";
+import type { MemoryViews } from "./memory-views";
+
+const encoder = new TextEncoder();
+
+// C EventTypes that are coalesced: a newer event on the same targets replaces the queued one, wheel
+// deltas add up
+const EVENT_INPUT = 2;
+const EVENT_POINTERMOVE = 6;
+const EVENT_WHEEL = 8;
+
+// Size of a C QueuedEvent {type, element_index, x, y, delta_x, delta_y, modifiers, value}
+const RECORD_SIZE = 32;
+
+function coalesces(queued: DelegatedEvent, event: DelegatedEvent) {
+  if (queued.type !== event.type || queued.modifiers !== event.modifiers) {
+    return false;
+  }
+  if (event.type !== EVENT_INPUT && event.type !== EVENT_POINTERMOVE && event.type !== EVENT_WHEEL) {
+    return false;
+  }
+  return (
+    queued.targets.length === event.targets.length &&
+    queued.targets.every((target, i) => target.index === event.targets[i].index)
+  );
+}
+
+// Appends events to the C EventQueue {count, capacity, items, text_size, text_capacity, text}, one
+// record per target. reserve makes room and returns the address of the queue, it can grow memory.
+export class EventQueueWriter {
+  #memory: MemoryViews;
+  #reserve: (records: number, textSize: number) => number;
+  // The last event appended and where its records are, for coalescing
+  #last: { event: DelegatedEvent; start: number; end: number } | undefined;
+
+  constructor(memory: MemoryViews, reserve: (records: number, textSize: number) => number) {
+    this.#memory = memory;
+    this.#reserve = reserve;
+  }
+
+  append(event: DelegatedEvent) {
+    // UTF-8 takes at most 3 bytes per UTF-16 code unit, plus the terminator
+    const valueSize = event.value === undefined ? 0 : event.value.length * 3 + 1;
+    const queue = this.#reserve(event.targets.length, valueSize);
+
+    // Views are only taken after reserving
+    const memory = this.#memory;
+    const u8 = memory.u8;
+    const u32 = memory.u32;
+    const count = memory.readU32(queue);
+    const itemsPtr = memory.readU32(queue + 8);
+
+    let value = 0;
+    if (event.value !== undefined) {
+      const textSize = memory.readU32(queue + 12);
+      const textPtr = memory.readU32(queue + 20) + textSize;
+      const { written } = encoder.encodeInto(event.value, u8.subarray(textPtr, textPtr + valueSize - 1));
+      u8[textPtr + written] = 0;
+      u32[(queue + 12) >>> 2] = textSize + written + 1;
+      value = textSize + 1;
+    }
+
+    // Only while nothing was drained or appended since the last event, the queue count tells both
+    const last = this.#last;
+    const coalesce = last !== undefined && last.end === count && coalesces(last.event, event);
+    const start = coalesce ? last.start : count;
+
+    event.targets.forEach((target, i) => {
+      const record = (itemsPtr + (start + i) * RECORD_SIZE) >>> 2;
+      const deltaX = coalesce ? u32[record + 4] | 0 : 0;
+      const deltaY = coalesce ? u32[record + 5] | 0 : 0;
+      u32[record] = event.type;
+      u32[record + 1] = target.index;
+      u32[record + 2] = target.x;
+      u32[record + 3] = target.y;
+      u32[record + 4] = deltaX + event.deltaX;
+      u32[record + 5] = deltaY + event.deltaY;
+      u32[record + 6] = event.modifiers;
+      u32[record + 7] = value;
+    });
+
+    const end = start + event.targets.length;
+    u32[queue >>> 2] = end;
+    this.#last = { event, start, end };
+  }
+}
@@ -0,0 +1,136 @@
+// Snapshots of the linear memory of an initialized component, restored into new instances of the
+// same module instead of running init_component again.
+//
+// Blob layout, all u32 little endian:
+//   magic, version, 32 byte SHA-256 of the module, memory length, callback count,
+//   callback pointers, then the memory bytes [0, memory length)
+//
+// Everything the C side knows lives in linear memory, including the bump pointer of the arenas.
+// The only mutable wasm global, the stack pointer, is back at its initial value whenever control is
+// back in JS, so it does not need to be saved. Animation frame callbacks are registered with the
+// host, their pointers are part of the snapshot.
+
+const SNAPSHOT_MAGIC = 0x52444e53; // "SNDR"
+// Bump when the layout above or the meaning of its contents changes
+const SNAPSHOT_VERSION = 1;
+const HASH_SIZE = 32;
+const HEADER_SIZE = 4 + 4 + HASH_SIZE + 4 + 4;
+
+export type MemorySnapshot = {
+  memory: Uint8Array;
+  animationFrameCallbacks: number[];
+};
+
+export async function hashModule(bytes: ArrayBuffer) {
+  return new Uint8Array(await crypto.subtle.digest("SHA-256", bytes));
+}
+
+export function encodeSnapshot(hash: Uint8Array, snapshot: MemorySnapshot) {
+  const callbacks = snapshot.animationFrameCallbacks;
+  const size = HEADER_SIZE + callbacks.length * 4 + snapshot.memory.length;
+  const blob = new Uint8Array(size);
+  const view = new DataView(blob.buffer);
+
+  view.setUint32(0, SNAPSHOT_MAGIC, true);
+  view.setUint32(4, SNAPSHOT_VERSION, true);
+  blob.set(hash, 8);
+  view.setUint32(8 + HASH_SIZE, snapshot.memory.length, true);
+  view.setUint32(12 + HASH_SIZE, callbacks.length, true);
+  callbacks.forEach((callback, i) => view.setUint32(HEADER_SIZE + i * 4, callback, true));
+  blob.set(snapshot.memory, HEADER_SIZE + callbacks.length * 4);
+
+  return blob;
+}
+
+// Returns undefined for blobs of another format version or another module
+export function decodeSnapshot(hash: Uint8Array, blob: Uint8Array): MemorySnapshot | undefined {
+  if (blob.length < HEADER_SIZE) {
+    return undefined;
+  }
+
+  const view = new DataView(blob.buffer, blob.byteOffset, blob.byteLength);
+  if (view.getUint32(0, true) !== SNAPSHOT_MAGIC || view.getUint32(4, true) !== SNAPSHOT_VERSION) {
+    return undefined;
+  }
+  for (let i = 0; i < HASH_SIZE; i++) {
+    if (blob[8 + i] !== hash[i]) {
+      return undefined;
+    }
+  }
+
+  const memoryLength = view.getUint32(8 + HASH_SIZE, true);
+  const callbackCount = view.getUint32(12 + HASH_SIZE, true);
+  const memoryStart = HEADER_SIZE + callbackCount * 4;
+  if (memoryStart + memoryLength !== blob.length) {
+    return undefined;
+  }
+
+  const animationFrameCallbacks: number[] = [];
+  for (let i = 0; i < callbackCount; i++) {
+    animationFrameCallbacks.push(view.getUint32(HEADER_SIZE + i * 4, true));
+  }
+
+  return { memory: blob.subarray(memoryStart), animationFrameCallbacks };
+}
+
+// Copies memory up to the end of the heap, nothing above it was ever written. arena.h only grows
+// memory up to the start of a new region, so the end of the heap may lie past the end of memory.
+export function captureSnapshot(memory: WebAssembly.Memory, heapEnd: number, animationFrameCallbacks: number[]) {
+  const length = Math.min(heapEnd, memory.buffer.byteLength);
+  return { memory: new Uint8Array(memory.buffer, 0, length).slice(), animationFrameCallbacks };
+}
+
+// Overwrites the memory of a fresh instance, including what its data segments initialized
+export function restoreSnapshot(memory: WebAssembly.Memory, snapshot: MemorySnapshot) {
+  const missing = snapshot.memory.length - memory.buffer.byteLength;
+  if (missing > 0) {
+    memory.grow(Math.ceil(missing / 65536));
+  }
+  new Uint8Array(memory.buffer).set(snapshot.memory);
+}
+
+// Snapshots are kept in Cache Storage across page loads, one per module URL. A rebuilt module has
+// another hash, its stale snapshot is rejected by decodeSnapshot and replaced on the next init.
+const SNAPSHOT_CACHE = "sandor-snapshots";
+// Snapshots already loaded or stored by this page
+const snapshots = new Map<string, Uint8Array>();
+
+function snapshotKey(moduleUrl: string) {
+  return `https://sandor.invalid/snapshot?module=${encodeURIComponent(moduleUrl)}`;
+}
+
+export async function loadSnapshot(moduleUrl: string) {
+  const loaded = snapshots.get(moduleUrl);
+  if (loaded || typeof caches === "undefined") {
+    return loaded;
+  }
+
+  // Cache Storage is unavailable on insecure origins and in some private modes, it is only a speedup
+  try {
+    const cache = await caches.open(SNAPSHOT_CACHE);
+    const response = await cache.match(snapshotKey(moduleUrl));
+    if (!response) {
+      return undefined;
+    }
+    const blob = new Uint8Array(await response.arrayBuffer());
+    snapshots.set(moduleUrl, blob);
+    return blob;
+  } catch (error) {
+    console.warn("Could not load memory snapshot", error);
+    return undefined;
+  }
+}
+
+export async function storeSnapshot(moduleUrl: string, blob: Uint8Array) {
+  snapshots.set(moduleUrl, blob);
+  if (typeof caches === "undefined") {
+    return;
+  }
+
+  try {
+    const cache = await caches.open(SNAPSHOT_CACHE);
+    await cache.put(snapshotKey(moduleUrl), new Response(blob));
+  } catch (error) {
+    console.warn("Could not store memory snapshot", error);
+  }
+}
@@ -0,0 +1,88 @@
+const decoder = new TextDecoder();
+
+// Typed views over the linear memory of a wasm instance, shared by every read of the bridge
+// The views are only recreated after memory.grow, which replaces memory.buffer and detaches the old one
+export class MemoryViews {
+  #memory: WebAssembly.Memory;
+  #buffer: ArrayBuffer;
+  #dataView: DataView;
+  #u8: Uint8Array;
+  #u32: Uint32Array;
+  #i32: Int32Array;
+
+  constructor(memory: WebAssembly.Memory) {
+    this.#memory = memory;
+    this.#buffer = memory.buffer;
+    this.#dataView = new DataView(this.#buffer);
+    this.#u8 = new Uint8Array(this.#buffer);
+    this.#u32 = new Uint32Array(this.#buffer);
+    this.#i32 = new Int32Array(this.#buffer);
+  }
+
+  // Recreates the views if memory grew since they were taken, any call into wasm can grow it
+  refresh() {
+    const buffer = this.#memory.buffer;
+    if (buffer === this.#buffer) {
+      return;
+    }
+
+    this.#buffer = buffer;
+    this.#dataView = new DataView(buffer);
+    this.#u8 = new Uint8Array(buffer);
+    this.#u32 = new Uint32Array(buffer);
+    this.#i32 = new Int32Array(buffer);
+  }
+
+  get buffer() {
+    this.refresh();
+    return this.#buffer;
+  }
+
+  get dataView() {
+    this.refresh();
+    return this.#dataView;
+  }
+
+  get u8() {
+    this.refresh();
+    return this.#u8;
+  }
+
+  get u32() {
+    this.refresh();
+    return this.#u32;
+  }
+
+  get i32() {
+    this.refresh();
+    return this.#i32;
+  }
+
+  // Reads a u32 at a 4 byte aligned address, like every field of the C structs read by the bridge
+  readU32(address: number) {
+    return this.u32[address >>> 2];
+  }
+
+  // Decodes length bytes of UTF-8 at address
+  readBytesAsString(address: number, length: number) {
+    return decoder.decode(this.u8.subarray(address, address + length));
+  }
+
+  // Whether the NUL terminated string at address consists of bytes, compared without decoding it
+  stringEquals(address: number, bytes: Uint8Array) {
+    const u8 = this.u8;
+    for (let i = 0; i < bytes.length; i++) {
+      if (u8[address + i] !== bytes[i]) {
+        return false;
+      }
+    }
+    return u8[address + bytes.length] === 0;
+  }
+
+  // Decodes the NUL terminated UTF-8 string at address
+  readString(address: number) {
+    const u8 = this.u8;
+    const end = u8.indexOf(0, address);
+    return decoder.decode(u8.subarray(address, end === -1 ? undefined : end));
+  }
+}
@@ -0,0 +1,71 @@
+import { hashModule } from "./memory-snapshot";
+import { assertAndGet } from "./util/assert-value";
+
+// A compiled module along with the SHA-256 of its bytes, which identifies it for memory snapshots.
+// Both can be posted to a worker.
+export type CompiledModule = {
+  module: WebAssembly.Module;
+  hash: Uint8Array;
+};
+
+// Compiled modules by URL, every app is fetched and compiled once per page
+const modules = new Map<string, Promise<CompiledModule>>();
+
+export function compileModule(url: string) {
+  let module = modules.get(url);
+  if (!module) {
+    module = fetch(url).then(async (response) => {
+      if (!response.ok) {
+        throw new Error(`Could not fetch ${url}: ${response.status}`);
+      }
+      // Compiling still streams, the bytes are only read a second time for the hash
+      const [module, hash] = await Promise.all([
+        WebAssembly.compileStreaming(response.clone()),
+        response.arrayBuffer().then(hashModule),
+      ]);
+      return { module, hash };
+    });
+    // A failed fetch is not cached, the next use tries again
+    module.catch(() => modules.delete(url));
+    modules.set(url, module);
+  }
+  return module;
+}
+
+// For hosts without fetch of local files, like Node
+export async function compileModuleBytes(bytes: ArrayBuffer): Promise<CompiledModule> {
+  const [module, hash] = await Promise.all([WebAssembly.compile(bytes), hashModule(bytes)]);
+  return { module, hash };
+}
+
+// How many instances are kept warm across all apps and execution modes, each of them holds on to its
+// whole linear memory
+const WARM_POOL_CAPACITY = 4;
+
+// Entries of every pool, least recently released first, so the capacity is shared between them
+const warmEntries: { pool: object; key: string; value: unknown; drop: () => void }[] = [];
+
+// Instances of apps that are not shown right now, kept alive to be reused when the app is shown again.
+// The least recently released one of any pool is dropped once they are full.
+export class WarmPool<T> {
+  drop: (value: T) => void;
+
+  constructor(drop: (value: T) => void) {
+    this.drop = drop;
+  }
+
+  acquire(key: string) {
+    const index = warmEntries.findIndex((entry) => entry.pool === this && entry.key === key);
+    if (index === -1) {
+      return undefined;
+    }
+    return warmEntries.splice(index, 1)[0].value as T;
+  }
+
+  release(key: string, value: T) {
+    warmEntries.push({ pool: this, key, value, drop: () => this.drop(value) });
+    while (warmEntries.length > WARM_POOL_CAPACITY) {
+      assertAndGet(warmEntries.shift(), "Pool is empty").drop();
+    }
+  }
+}
@@ -0,0 +1,74 @@
+import type { MemoryViews } from "./memory-views";
+
+// Console methods by the log levels of sandor.h: debug, info, warn, error
+const logMethods: ((message: string) => void)[] = [
+  (message) => console.debug(message),
+  (message) => console.log(message),
+  (message) => console.warn(message),
+  (message) => console.error(message),
+];
+
+// Reads the C LogRing {head, tail, capacity, items} at address. Every message is a level byte, its
+// UTF-8 text and a NUL. Messages longer than the ring arrive over several drains and are put back
+// together here.
+export class LogReader {
+  #memory: MemoryViews;
+  #address: number;
+  #decoder = new TextDecoder();
+  // Level of the message being read, undefined until its level byte arrived
+  #level: number | undefined;
+  #text = "";
+
+  constructor(memory: MemoryViews, address: number) {
+    this.#memory = memory;
+    this.#address = address;
+  }
+
+  // Cheap enough to check after every call into wasm
+  get pending() {
+    return this.#memory.readU32(this.#address) !== this.#memory.readU32(this.#address + 4);
+  }
+
+  // Prints every message in the ring and hands the space back to wasm
+  drain() {
+    const memory = this.#memory;
+    const head = memory.readU32(this.#address);
+    const capacity = memory.readU32(this.#address + 8);
+    const itemsPtr = memory.readU32(this.#address + 12);
+    const u8 = memory.u8;
+
+    // head and tail wrap around at 2^32, capacity is a power of two
+    let tail = memory.readU32(this.#address + 4);
+    while (tail !== head) {
+      const offset = tail & (capacity - 1);
+      const end = Math.min(capacity, offset + ((head - tail) >>> 0));
+      this.read(u8.subarray(itemsPtr + offset, itemsPtr + end));
+      tail = (tail + end - offset) >>> 0;
+    }
+
+    memory.u32[(this.#address + 4) >>> 2] = head;
+  }
+
+  read(bytes: Uint8Array) {
+    let start = 0;
+    while (start < bytes.length) {
+      if (this.#level === undefined) {
+        this.#level = bytes[start++];
+        continue;
+      }
+
+      const end = bytes.indexOf(0, start);
+      if (end === -1) {
+        // A multi-byte character can be split between two chunks, streaming keeps its first bytes
+        this.#text += this.#decoder.decode(bytes.subarray(start), { stream: true });
+        return;
+      }
+
+      this.#text += this.#decoder.decode(bytes.subarray(start, end));
+      (logMethods[this.#level] ?? logMethods[1])(this.#text);
+      this.#level = undefined;
+      this.#text = "";
+      start = end + 1;
+    }
+  }
+}
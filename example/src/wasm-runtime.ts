@@ -0,0 +1,652 @@
+import { packPixels } from "./canvas-presenter";
+import type { DelegatedEvent } from "./dom-patcher";
+import { EventQueueWriter } from "./event-queue";
+import { captureSnapshot, decodeSnapshot, encodeSnapshot, restoreSnapshot } from "./memory-snapshot";
+import { MemoryViews } from "./memory-views";
+import { type CompiledModule, compileModule } from "./module-registry";
+import { assertAndGet } from "./util/assert-value";
+import { LogReader } from "./wasm-log";
+
+const encoder = new TextEncoder();
+
+// Links of a NodeStore that lead nowhere, matching C NODE_NONE
+export const NODE_NONE = 0xffffffff;
+
+type WasmInstance = {
+  exports: {
+    memory: WebAssembly.Memory;
+    render_component: () => number;
+    init_component?: () => void;
+    reset_render_state: () => void;
+    invoke_on_scroll: (elementIndex: number, scrollTop: number, viewportHeight: number) => void;
+    invoke_queued_events: () => void;
+    reserve_events: (records: number, textSize: number) => number;
+    get_heap_end: () => number;
+    get_log_ring: () => number;
+    get_frame_stats: () => number;
+    get_node_store: () => number;
+    invoke_animation_frame_callback: (callbackPtr: number, dt: number, visible: boolean) => void;
+  };
+};
+
+// How rerender requests from wasm are flushed:
+// - "animation-frame": at most one render per displayed frame
+// - "microtask": once the current task is done, before the browser paints
+// - "sync": immediately inside the request, as the bridge used to do
+export type RenderScheduling = "animation-frame" | "microtask" | "sync";
+
+export const renderSchedulings: readonly RenderScheduling[] = ["animation-frame", "microtask", "sync"];
+
+export type WasmRuntimeOptions = {
+  scheduling?: RenderScheduling;
+  // Snapshot blob to restore instead of running init_component, ignored if it is stale
+  snapshot?: Uint8Array;
+};
+
+// Where a runtime sends its output. The views passed in point into wasm memory and are only valid
+// during the call, a host that keeps them has to copy them.
+export type WasmRuntimeHost = {
+  // commands is the patch command stream of a render, strings its decoded string pool
+  patch(commands: Uint8Array, strings: string[]): void;
+  // pixels are the RGBA pixels of a width * height canvas, in height rows that are stride pixels
+  // long. dirty holds x, y, width and height of every region that changed since the last draw, it is
+  // undefined if all of them may have.
+  drawCanvas(
+    canvasId: string,
+    pixels: Uint8ClampedArray,
+    width: number,
+    height: number,
+    stride: number,
+    dirty: Int32Array | undefined
+  ): void;
+  // Receives the memory snapshot taken right after init_component, the blob belongs to the host
+  snapshot?(blob: Uint8Array): void;
+};
+
+// Dedicated workers do not have requestAnimationFrame in every browser, and Node has none
+const requestFrame: (callback: FrameRequestCallback) => number =
+  typeof requestAnimationFrame === "function"
+    ? (callback) => requestAnimationFrame(callback)
+    : (callback) => setTimeout(() => callback(performance.now()), 1000 / 60) as unknown as number;
+
+const cancelFrame: (handle: number) => void =
+  typeof cancelAnimationFrame === "function"
+    ? (handle) => cancelAnimationFrame(handle)
+    : (handle) => clearTimeout(handle);
+
+const libm = {
+  atan2f: Math.atan2,
+  cosf: Math.cos,
+  sinf: Math.sin,
+  sqrtf: Math.sqrt,
+};
+
+// Runs a sandor component: owns the wasm instance, schedules its renders and animation frames and
+// calls into it for events. It has no DOM access, so it runs on the main thread or in a worker.
+export class WasmRuntime {
+  #instance: (WebAssembly.Instance & WasmInstance) | undefined;
+  #memory: MemoryViews | undefined;
+  #log: LogReader | undefined;
+  #events: EventQueueWriter | undefined;
+  // A URL to fetch the module from, or an already compiled module
+  source: string | CompiledModule;
+  hash: Uint8Array | undefined;
+  host: WasmRuntimeHost;
+  scheduling: RenderScheduling;
+  snapshot: Uint8Array | undefined;
+  initialized = false;
+  // Set when the memory was restored from a snapshot, init_component already ran in it
+  restored = false;
+  // Incremented by every render, element indices handed out by a render are valid until the next
+  frame = 0;
+
+  // Map pointer to animation frame callbacks, they stay registered while the runtime is suspended
+  animationFrameCallbacks = new Map<number, (time: number) => void>();
+  animationFrameHandle: number = 0;
+  // Start of the last display frame that ran the callbacks and how long they took, for FrameStats
+  lastFrameTime = 0;
+  lastFrameWork = 0;
+  // Canvases every animation frame callback presented the last time it presented any, it is visible
+  // while one of them is. Collected while the callback runs.
+  animationCanvases = new Map<number, string[]>();
+  presentedCanvases: string[] | undefined;
+  // Reported by the host. Canvases that were not reported are hidden, the host may not have created
+  // them yet.
+  canvasVisibility = new Map<string, boolean>();
+  documentVisible = true;
+  documentVisibleSince = 0;
+
+  // Canvases drawn so far by the address of their id, with the view of their pixels. The view is
+  // reused until the canvas changes its pixels or size, or memory grows.
+  canvases = new Map<number, { id: string; idBytes: Uint8Array; pixels: Uint8ClampedArray }>();
+  // Olivec_Dirty lists presented by the current call into wasm, cleared once it returns
+  presentedDirty = new Set<number>();
+  // Rects clipped to a subcanvas, overwritten by the next one. Hosts use them before drawCanvas returns.
+  dirtyScratch = new Int32Array(64);
+
+  renderScheduled = false;
+  renderFrameHandle: number = 0;
+
+  eventsScheduled = false;
+  eventFrameHandle: number = 0;
+
+  logDrainHandle: number = 0;
+
+  constructor(source: string | CompiledModule, host: WasmRuntimeHost, options: WasmRuntimeOptions = {}) {
+    this.source = source;
+    this.host = host;
+    this.scheduling = options.scheduling ?? "animation-frame";
+    this.snapshot = options.snapshot;
+  }
+
+  get instance() {
+    return assertAndGet(this.#instance, "Instance not found");
+  }
+
+  get memory() {
+    return assertAndGet(this.#memory, "Memory views not found");
+  }
+
+  get events() {
+    return assertAndGet(this.#events, "Event queue not found");
+  }
+
+  get log() {
+    return assertAndGet(this.#log, "Log reader not found");
+  }
+
+  async init() {
+    const imports = {
+      env: {
+        ...libm,
+        platform_flush_log: () => {
+          this.log.drain();
+        },
+        platform_rerender: () => {
+          this.scheduleRender();
+        },
+        platform_render_now: () => {
+          this.render();
+        },
+        platform_on_animation_frame: (callbackPtr: number) => {
+          this.addAnimationFrameCallback(callbackPtr);
+          this.checkAndRunAnimationFrameCallbacks();
+        },
+        platform_clear_animation_frame: (callbackPtr: number) => {
+          this.animationFrameCallbacks.delete(callbackPtr);
+          this.checkAndRunAnimationFrameCallbacks();
+        },
+        platform_draw_canvas: (canvasIdPtr: number, canvasPtr: number) => {
+          this.drawCanvas(canvasIdPtr, canvasPtr);
+        },
+      },
+    };
+
+    const compiled = typeof this.source === "string" ? await compileModule(this.source) : this.source;
+    this.hash = compiled.hash;
+    this.#instance = (await WebAssembly.instantiate(compiled.module, imports)) as WasmInstance;
+
+    this.#memory = new MemoryViews(this.instance.exports.memory);
+    this.#log = new LogReader(this.#memory, this.instance.exports.get_log_ring());
+    this.#events = new EventQueueWriter(this.#memory, this.instance.exports.reserve_events);
+    this.restore();
+  }
+
+  restore() {
+    const snapshot = this.snapshot && this.hash && decodeSnapshot(this.hash, this.snapshot);
+    this.snapshot = undefined;
+    if (!snapshot) {
+      return;
+    }
+
+    restoreSnapshot(this.instance.exports.memory, snapshot);
+    for (const callbackPtr of snapshot.animationFrameCallbacks) {
+      this.addAnimationFrameCallback(callbackPtr);
+    }
+    this.restored = true;
+  }
+
+  // Only called between calls into wasm, when the stack is empty
+  takeSnapshot() {
+    if (!this.host.snapshot || !this.hash) {
+      return;
+    }
+
+    // Messages logged by init_component are printed once, not again by every restored instance
+    this.log.drain();
+    const snapshot = captureSnapshot(
+      this.instance.exports.memory,
+      this.instance.exports.get_heap_end(),
+      [...this.animationFrameCallbacks.keys()]
+    );
+    this.host.snapshot(encodeSnapshot(this.hash, snapshot));
+  }
+
+  destroy() {
+    this.suspend();
+    this.animationFrameCallbacks.clear();
+
+    // Clear instance and memory views
+    this.#instance = undefined;
+    this.#memory = undefined;
+    this.#log = undefined;
+    this.#events = undefined;
+    this.canvases.clear();
+    this.presentedDirty.clear();
+    this.animationCanvases.clear();
+    this.canvasVisibility.clear();
+
+    this.initialized = false;
+  }
+
+  // Stops all rendering and animation while the component is not shown, the instance stays warm
+  suspend() {
+    if (this.animationFrameHandle !== 0) {
+      cancelFrame(this.animationFrameHandle);
+      this.animationFrameHandle = 0;
+    }
+    this.cancelScheduledRender();
+    this.cancelScheduledEvents();
+
+    if (this.logDrainHandle !== 0) {
+      cancelFrame(this.logDrainHandle);
+      this.logDrainHandle = 0;
+    }
+    this.#log?.drain();
+  }
+
+  // Reuses a suspended runtime for a new host, which starts without any nodes. The application
+  // keeps its state and is not initialized again.
+  resume(host: WasmRuntimeHost, scheduling: RenderScheduling) {
+    this.host = host;
+    this.scheduling = scheduling;
+    this.instance.exports.reset_render_state();
+
+    // The time spent suspended does not count as a frame
+    for (const callbackPtr of [...this.animationFrameCallbacks.keys()]) {
+      this.addAnimationFrameCallback(callbackPtr);
+    }
+    this.lastFrameTime = 0;
+    // The canvases of the new host report their visibility once they are created
+    this.canvasVisibility.clear();
+  }
+
+  // Coalesces every rerender request until the next flush into a single render
+  scheduleRender() {
+    if (this.scheduling === "sync") {
+      this.render();
+      return;
+    }
+
+    if (this.renderScheduled) {
+      return;
+    }
+
+    this.renderScheduled = true;
+    if (this.scheduling === "microtask") {
+      queueMicrotask(this.flushScheduledRender);
+    } else {
+      this.renderFrameHandle = requestFrame(this.flushScheduledRender);
+    }
+  }
+
+  flushScheduledRender = () => {
+    this.renderFrameHandle = 0;
+    // Cancelled, or already flushed by an explicit render in the meantime
+    if (!this.renderScheduled || !this.#instance) {
+      return;
+    }
+
+    this.render();
+  };
+
+  cancelScheduledRender() {
+    if (this.renderFrameHandle !== 0) {
+      cancelFrame(this.renderFrameHandle);
+      this.renderFrameHandle = 0;
+    }
+    this.renderScheduled = false;
+  }
+
+  render() {
+    this.cancelScheduledRender();
+    // Rendering handles the queued events first
+    this.cancelScheduledEvents();
+
+    this.callWasm(() => {
+      if (!this.initialized && !this.restored) {
+        if (this.instance.exports.init_component) {
+          this.instance.exports.init_component();
+          this.takeSnapshot();
+        }
+      }
+
+      const outputAddr = this.instance.exports.render_component();
+      this.frame++;
+      this.patch(outputAddr);
+    });
+
+    // Animation starts with the first render, also after a resume, once the canvases exist
+    if (this.animationFrameHandle === 0) {
+      this.checkAndRunAnimationFrameCallbacks();
+    }
+
+    this.initialized = true;
+    this.scheduleLogDrain();
+  }
+
+  // Runs a call into wasm. A trap leaves the messages that led up to it in the log, they are printed
+  // before the error is thrown on.
+  callWasm(call: () => void) {
+    try {
+      call();
+    } catch (error) {
+      this.#log?.drain();
+      throw error;
+    }
+    this.clearPresentedDirty();
+  }
+
+  // Messages are printed at most once per frame, however many calls into wasm logged them
+  scheduleLogDrain() {
+    if (this.logDrainHandle !== 0 || !this.log.pending) {
+      return;
+    }
+
+    this.logDrainHandle = requestFrame(this.drainLog);
+  }
+
+  drainLog = () => {
+    this.logDrainHandle = 0;
+    this.#log?.drain();
+  };
+
+  // Hands the C RenderOutput at address to the host: commands {count, capacity, items} at +0,
+  // string pool {count, capacity, items} at +12
+  patch(address: number) {
+    const memory = this.memory;
+    const count = memory.readU32(address);
+    const itemsPtr = memory.readU32(address + 8);
+
+    // Every string of the render is decoded in a single call, the pool is NUL separated
+    const poolSize = memory.readU32(address + 12);
+    const poolPtr = memory.readU32(address + 20);
+    const strings = poolSize > 0 ? memory.readBytesAsString(poolPtr, poolSize).split("\0") : [];
+
+    this.host.patch(memory.u8.subarray(itemsPtr, itemsPtr + count), strings);
+  }
+
+  // Views of the C NodeStore of the last render, indexed by node id. After the node and attribute
+  // counts every field is a pointer to its array, strings are addresses for memory.readString. The
+  // views are only valid until the next call into wasm.
+  readNodeStore() {
+    const memory = this.memory;
+    const address = this.instance.exports.get_node_store();
+    const count = memory.readU32(address);
+    const u32 = (offset: number, length = count) => {
+      const start = memory.readU32(address + offset) >>> 2;
+      return memory.u32.subarray(start, start + length);
+    };
+    const typePtr = memory.readU32(address + 8);
+
+    return {
+      count,
+      type: memory.u8.subarray(typePtr, typePtr + count),
+      tag: u32(12),
+      tagId: u32(16),
+      text: u32(20),
+      key: u32(24),
+      firstChild: u32(28),
+      nextSibling: u32(32),
+      attributesStart: u32(36),
+      attributesCount: u32(40),
+      // name, value, name_id and value_id of every attribute
+      attributes: u32(44, memory.readU32(address + 4) * 4),
+      node: u32(48),
+      memo: u32(52),
+    };
+  }
+
+  addAnimationFrameCallback(callbackPtr: number) {
+    let time_prev = 0;
+    const callback = (time: number) => {
+      time_prev = time_prev || time;
+      const dt = (time - time_prev) / 1000; // Convert to seconds
+      const visible = this.isAnimationVisible(callbackPtr, time_prev);
+      time_prev = time;
+
+      this.presentedCanvases = [];
+      this.instance.exports.invoke_animation_frame_callback(callbackPtr, dt, visible);
+      if (this.presentedCanvases.length > 0) {
+        this.animationCanvases.set(callbackPtr, this.presentedCanvases);
+      }
+      this.presentedCanvases = undefined;
+    };
+    this.animationFrameCallbacks.set(callbackPtr, callback);
+  }
+
+  // Whether the callback has been visible since time, C pauses it otherwise
+  isAnimationVisible(callbackPtr: number, time: number) {
+    if (!this.documentVisible || this.documentVisibleSince > time) {
+      return false;
+    }
+
+    const canvases = this.animationCanvases.get(callbackPtr);
+    return !canvases || canvases.some((canvasId) => this.canvasVisibility.get(canvasId) === true);
+  }
+
+  // Without canvasId, the visibility of the whole document changed
+  setVisible(visible: boolean, canvasId?: string) {
+    if (canvasId !== undefined) {
+      this.canvasVisibility.set(canvasId, visible);
+      return;
+    }
+
+    // Frames that started before include hidden time
+    if (visible && !this.documentVisible) {
+      this.documentVisibleSince = performance.now();
+    }
+    this.documentVisible = visible;
+  }
+
+  runAnimationFrameCallbacks = (time: number) => {
+    this.writeFrameStats(time);
+
+    const start = performance.now();
+    this.callWasm(() => {
+      this.animationFrameCallbacks.forEach((callback) => {
+        callback(time);
+      });
+    });
+    this.lastFrameWork = performance.now() - start;
+
+    this.checkAndRunAnimationFrameCallbacks();
+    // Already inside a frame, what the callbacks logged is printed right away
+    this.log.drain();
+  };
+
+  // Updates the C FrameStats {frame_interval, frame_work, frames, dropped_steps}, in seconds
+  writeFrameStats(time: number) {
+    const address = this.instance.exports.get_frame_stats();
+    const view = this.memory.dataView;
+    view.setFloat32(address, this.lastFrameTime ? (time - this.lastFrameTime) / 1000 : 0, true);
+    view.setFloat32(address + 4, this.lastFrameWork / 1000, true);
+    view.setUint32(address + 8, view.getUint32(address + 8, true) + 1, true);
+    this.lastFrameTime = time;
+  }
+
+  checkAndRunAnimationFrameCallbacks() {
+    if (this.animationFrameHandle !== 0) {
+      cancelFrame(this.animationFrameHandle);
+      this.animationFrameHandle = 0;
+    }
+
+    if (this.animationFrameCallbacks.size > 0) {
+      this.animationFrameHandle = requestFrame(this.runAnimationFrameCallbacks);
+    }
+  }
+
+  // Queues the event for C, where the handlers of every target run innermost first. Queued events
+  // are handled by the next render, or in the next flush like render requests if none is due.
+  dispatchEvent(event: DelegatedEvent) {
+    this.events.append(event);
+    this.scheduleEvents();
+  }
+
+  scheduleEvents() {
+    if (this.scheduling === "sync") {
+      this.flushEvents();
+      return;
+    }
+
+    if (this.eventsScheduled) {
+      return;
+    }
+
+    this.eventsScheduled = true;
+    if (this.scheduling === "microtask") {
+      queueMicrotask(this.flushScheduledEvents);
+    } else {
+      this.eventFrameHandle = requestFrame(this.flushScheduledEvents);
+    }
+  }
+
+  flushScheduledEvents = () => {
+    this.eventFrameHandle = 0;
+    // Cancelled, or already handled by a render in the meantime
+    if (!this.eventsScheduled || !this.#instance) {
+      return;
+    }
+
+    this.flushEvents();
+  };
+
+  flushEvents() {
+    this.eventsScheduled = false;
+    this.callWasm(() => this.instance.exports.invoke_queued_events());
+
+    // Handlers that changed state are rendered in the same frame, not in the next one
+    if (this.renderScheduled) {
+      this.render();
+    }
+    this.scheduleLogDrain();
+  }
+
+  cancelScheduledEvents() {
+    if (this.eventFrameHandle !== 0) {
+      cancelFrame(this.eventFrameHandle);
+      this.eventFrameHandle = 0;
+    }
+    this.eventsScheduled = false;
+  }
+
+  scroll(index: number, scrollTop: number, viewportHeight: number) {
+    this.callWasm(() => this.instance.exports.invoke_on_scroll(index, scrollTop, viewportHeight));
+    this.scheduleLogDrain();
+  }
+
+  // Hands the pixels of the Olivec_Canvas {pixels, width, height, stride, dirty} at canvasPtr to the
+  // host, along with the rects of its Olivec_Dirty {origin, count, rects} if it tracks them. A
+  // subcanvas is handed over as the rows of the canvas it is part of, without copying.
+  drawCanvas(canvasIdPtr: number, canvasPtr: number) {
+    const memory = this.memory;
+    const pixelsPtr = memory.readU32(canvasPtr);
+    const width = memory.readU32(canvasPtr + 4);
+    const height = memory.readU32(canvasPtr + 8);
+    const stride = memory.readU32(canvasPtr + 12);
+    if (width > stride) {
+      console.error(`Canvas width (${width}) is greater than its stride (${stride}).`);
+      return;
+    }
+
+    let canvas = this.canvases.get(canvasIdPtr);
+    if (!canvas || !memory.stringEquals(canvasIdPtr, canvas.idBytes)) {
+      const id = this.readString(canvasIdPtr);
+      canvas = { id, idBytes: encoder.encode(id), pixels: new Uint8ClampedArray(0) };
+      this.canvases.set(canvasIdPtr, canvas);
+    }
+
+    // The view covers whole rows, the last row of a subcanvas at the very end of memory does not fit
+    // and it is copied instead
+    const pixels = canvas.pixels;
+    const size = stride * height * 4;
+    let pixelsStride = stride;
+    if (pixelsPtr + size > memory.buffer.byteLength) {
+      const rows = new Uint8ClampedArray(memory.buffer, pixelsPtr, ((height - 1) * stride + width) * 4);
+      canvas.pixels = packPixels(rows, width, height, stride);
+      pixelsStride = width;
+    } else if (pixels.buffer !== memory.buffer || pixels.byteOffset !== pixelsPtr || pixels.length !== size) {
+      canvas.pixels = new Uint8ClampedArray(memory.buffer, pixelsPtr, size);
+    }
+
+    if (this.presentedCanvases && !this.presentedCanvases.includes(canvas.id)) {
+      this.presentedCanvases.push(canvas.id);
+    }
+    // An animation learns its canvases by presenting them, one the host has not reported yet does not
+    // exist there. The callback is paused until it is reported visible, the first present is whole.
+    if (this.presentedCanvases && !this.canvasVisibility.has(canvas.id)) {
+      return;
+    }
+
+    const dirty = this.readDirty(memory.readU32(canvasPtr + 16), pixelsPtr, width, height, stride);
+    this.host.drawCanvas(canvas.id, canvas.pixels, width, height, pixelsStride, dirty);
+  }
+
+  // Rects of the Olivec_Dirty at dirtyPtr within the canvas at pixelsPtr, relative to it. They are
+  // kept until the call into wasm returns, every subcanvas of the same canvas it presents gets them.
+  // Rects are clipped to the canvas, those of a canvas presented whole may still lie partly outside
+  // of it. The result views dirtyScratch, so it is only valid until drawCanvas returns.
+  readDirty(dirtyPtr: number, pixelsPtr: number, width: number, height: number, stride: number) {
+    if (dirtyPtr === 0) {
+      return undefined;
+    }
+
+    // Rects of tracking started on another canvas do not apply to this one
+    const memory = this.memory;
+    const offset = pixelsPtr - memory.readU32(dirtyPtr);
+    if (offset < 0 || offset % 4 !== 0) {
+      return undefined;
+    }
+
+    this.presentedDirty.add(dirtyPtr);
+    const i32 = memory.i32;
+    const start = (dirtyPtr + 8) >>> 2;
+    const end = start + memory.readU32(dirtyPtr + 4) * 4;
+    const left = (offset / 4) % stride;
+    const top = Math.floor(offset / 4 / stride);
+    if (this.dirtyScratch.length < end - start) {
+      this.dirtyScratch = new Int32Array(end - start);
+    }
+    const clipped = this.dirtyScratch;
+    let length = 0;
+    for (let i = start; i < end; i += 4) {
+      const x1 = Math.max(i32[i], left);
+      const y1 = Math.max(i32[i + 1], top);
+      const x2 = Math.min(i32[i] + i32[i + 2], left + width);
+      const y2 = Math.min(i32[i + 1] + i32[i + 3], top + height);
+      if (x1 < x2 && y1 < y2) {
+        clipped[length++] = x1 - left;
+        clipped[length++] = y1 - top;
+        clipped[length++] = x2 - x1;
+        clipped[length++] = y2 - y1;
+      }
+    }
+    return clipped.subarray(0, length);
+  }
+
+  // Presented, drawing collects the next rects from scratch
+  clearPresentedDirty() {
+    for (const dirtyPtr of this.presentedDirty) {
+      this.memory.u32[(dirtyPtr + 4) >>> 2] = 0;
+    }
+    this.presentedDirty.clear();
+  }
+
+  readString(address: number) {
+    if (address === 0) {
+      throw new Error("Null pointer dereference");
+    }
+
+    return this.memory.readString(address);
+  }
+}
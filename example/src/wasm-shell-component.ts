@@ -1,17 +1,33 @@
-import { WasmComponent } from "./wasm-component";
+import { type RenderScheduling, renderSchedulings, WasmComponent } from "./wasm-component";
+import { WasmWorkerComponent } from "./wasm-worker-component";
 import { assertAndGet } from "./util/assert-value";
 import stylesheet from "../style.css?inline";
 
+// Where the wasm of an app runs:
+// - "main": on the main thread, renders are applied synchronously
+// - "worker": in a worker, only DOM patches and canvas pixels are posted to the main thread
+export type Execution = "main" | "worker";
+
+export const executions: readonly Execution[] = ["main", "worker"];
+
+// Every shell adopts the same parsed sheet instead of parsing the stylesheet again
+let sharedStyleSheet: CSSStyleSheet | undefined;
+
+function styleSheet() {
+  if (!sharedStyleSheet) {
+    sharedStyleSheet = new CSSStyleSheet();
+    sharedStyleSheet.replaceSync(stylesheet);
+  }
+  return sharedStyleSheet;
+}
+
 class WasmShellComponent extends HTMLElement {
-  wasmComponent: WasmComponent | undefined;
+  wasmComponent: WasmComponent | WasmWorkerComponent | undefined;
 
   constructor() {
     super();
     this.attachShadow({ mode: "open" });
-    const sheet = new CSSStyleSheet();
-    sheet.replaceSync(stylesheet);
-
-    this.shadowRoot?.adoptedStyleSheets.push(sheet);
+    this.shadowRoot.adoptedStyleSheets.push(styleSheet());
 
     this.shadowRoot.innerHTML = `
       <div id="root" class="h-full"></div>
@@ -22,9 +38,41 @@ class WasmShellComponent extends HTMLElement {
     return assertAndGet(super.shadowRoot, "Could not find shadow root");
   }
 
+  // Optional "scheduling" attribute, see RenderScheduling
+  get scheduling(): RenderScheduling | undefined {
+    const scheduling = this.getAttribute("scheduling");
+    if (scheduling === null) {
+      return undefined;
+    }
+
+    const match = renderSchedulings.find((value) => value === scheduling);
+    if (!match) {
+      throw new Error(`Unknown render scheduling: ${scheduling}`);
+    }
+    return match;
+  }
+
+  // Optional "execution" attribute, see Execution
+  get execution(): Execution {
+    const execution = this.getAttribute("execution");
+    if (execution === null) {
+      return "main";
+    }
+
+    const match = executions.find((value) => value === execution);
+    if (!match) {
+      throw new Error(`Unknown execution: ${execution}`);
+    }
+    return match;
+  }
+
   async connectedCallback() {
     const name = this.getAttribute("name") || "test";
-    this.wasmComponent = new WasmComponent(`./${name}.wasm`);
+    const options = { scheduling: this.scheduling };
+    this.wasmComponent =
+      this.execution === "worker"
+        ? new WasmWorkerComponent(`./${name}.wasm`, options)
+        : new WasmComponent(`./${name}.wasm`, options);
 
     const root = this.shadowRoot.getElementById("root");
 
@@ -0,0 +1,164 @@
+import { type DelegatedEvent, DomPatcher } from "./dom-patcher";
+import { loadSnapshot, storeSnapshot } from "./memory-snapshot";
+import { type CompiledModule, compileModule, WarmPool } from "./module-registry";
+import type { MessageEndpoint, WorkerRequest, WorkerResponse } from "./wasm-worker";
+import type { RenderScheduling } from "./wasm-runtime";
+import { assertAndGet } from "./util/assert-value";
+
+export type WasmWorkerComponentOptions = {
+  scheduling?: RenderScheduling;
+  // Connects to an already running serveWasmRuntime instead of starting a worker, e.g. in Node
+  endpoint?: MessageEndpoint;
+  // Runs this module instead of fetching wasmPath, Node cannot fetch local files
+  module?: CompiledModule;
+};
+
+// Workers of components that were destroyed, by module URL, their runtimes are suspended
+const workerPool = new WarmPool<Worker>((worker) => worker.terminate());
+
+// Runs a sandor component in a worker, only the DOM patches and canvas pixels it produces are
+// applied on the main thread. Heavy C code no longer blocks scrolling and input. Where supported,
+// canvases are transferred to the worker and presented there, without any work on the main thread.
+export class WasmWorkerComponent {
+  #patcher: DomPatcher | undefined;
+  #worker: Worker | undefined;
+  #listener: ((message: MessageEvent<WorkerResponse>) => void) | undefined;
+  endpoint: MessageEndpoint | undefined;
+  module: CompiledModule | undefined;
+  wasmPath: string;
+  scheduling: RenderScheduling;
+  instanceId = crypto.randomUUID();
+  // Number of patches applied, events are tagged with it so the worker can drop stale ones
+  frame = 0;
+
+  constructor(wasmPath: string, options: WasmWorkerComponentOptions = {}) {
+    this.wasmPath = wasmPath;
+    this.scheduling = options.scheduling ?? "animation-frame";
+    this.endpoint = options.endpoint;
+    this.module = options.module;
+  }
+
+  get patcher() {
+    return assertAndGet(this.#patcher, "Patcher not found");
+  }
+
+  // Module URLs are absolute, the worker would resolve relative ones against its own URL
+  get moduleUrl() {
+    return new URL(this.wasmPath, document.baseURI).href;
+  }
+
+  async init(parent: HTMLElement) {
+    this.#patcher = new DomPatcher(parent, this, this.instanceId);
+
+    const warm = this.endpoint ? undefined : workerPool.acquire(this.moduleUrl);
+    if (!this.endpoint) {
+      this.#worker = warm ?? new Worker(new URL("./wasm-worker-entry.ts", import.meta.url), { type: "module" });
+      this.endpoint = this.#worker;
+    }
+
+    const endpoint = this.endpoint;
+    const ready = new Promise<void>((resolve, reject) => {
+      // A warm worker may still have output of its previous component in flight, that is dropped
+      let isReady = false;
+      this.#listener = (message: MessageEvent<WorkerResponse>) => {
+        const response = message.data;
+        switch (response.type) {
+          case "ready":
+            isReady = true;
+            this.frame = response.frame;
+            resolve();
+            break;
+
+          case "error":
+            reject(new Error(response.message));
+            break;
+
+          case "patch":
+            // Output of the previous component of a warm worker, or destroyed while in flight
+            if (!isReady || !this.#patcher) {
+              return;
+            }
+            this.#patcher.applyRenderCommands(response.commands, 0, response.commands.length, response.strings);
+            this.frame++;
+            break;
+
+          case "canvas":
+            if (isReady) {
+              const { canvasId, pixels, width, height, dirty } = response;
+              this.#patcher?.drawCanvas(canvasId, pixels, width, height, width, dirty);
+            }
+            break;
+
+          case "snapshot":
+            storeSnapshot(this.moduleUrl, response.blob);
+            break;
+        }
+      };
+      endpoint.addEventListener("message", this.#listener);
+    });
+    endpoint.start?.();
+
+    if (warm) {
+      this.post({ type: "resume", scheduling: this.scheduling });
+    } else {
+      // Modules are compiled once on the main thread, compiled modules can be posted to workers
+      const [source, snapshot] = await Promise.all([
+        this.module ?? compileModule(this.moduleUrl),
+        loadSnapshot(this.moduleUrl),
+      ]);
+      this.post({ type: "init", source, snapshot, scheduling: this.scheduling });
+    }
+    await ready;
+  }
+
+  // A worker started by the component is kept warm for the next component of the same module
+  destroy() {
+    if (this.#listener) {
+      this.endpoint?.removeEventListener("message", this.#listener);
+      this.#listener = undefined;
+    }
+
+    if (this.#worker) {
+      this.post({ type: "suspend" });
+      workerPool.release(this.moduleUrl, this.#worker);
+      this.#worker = undefined;
+      this.endpoint = undefined;
+    } else {
+      this.post({ type: "destroy" });
+    }
+    this.#patcher?.destroy();
+    this.#patcher = undefined;
+  }
+
+  post(request: WorkerRequest, transfer: Transferable[] = []) {
+    this.endpoint?.postMessage(request, transfer);
+  }
+
+  render() {
+    this.post({ type: "render" });
+  }
+
+  dispatchEvent(event: DelegatedEvent) {
+    this.post({ type: "event", frame: this.frame, event });
+  }
+
+  scroll(index: number, scrollTop: number, viewportHeight: number) {
+    this.post({ type: "scroll", frame: this.frame, index, scrollTop, viewportHeight });
+  }
+
+  setVisible(visible: boolean, canvasId?: string) {
+    this.post({ type: "visibility", visible, canvasId });
+  }
+
+  attachCanvas(canvasId: string, node: number, canvas: OffscreenCanvas) {
+    this.post({ type: "attach-canvas", canvasId, node, canvas }, [canvas]);
+  }
+
+  updateCanvas(canvasId: string, node: number, width: number, height: number) {
+    this.post({ type: "update-canvas", canvasId, node, width, height });
+  }
+
+  detachCanvas(canvasId: string, node: number) {
+    this.post({ type: "detach-canvas", canvasId, node });
+  }
+}
@@ -0,0 +1,4 @@
+import { type MessageEndpoint, serveWasmRuntime } from "./wasm-worker";
+
+// Entry point of the worker started by WasmWorkerComponent
+serveWasmRuntime(self as unknown as MessageEndpoint);
@@ -0,0 +1,164 @@
+import { CanvasPresenter, packPixels } from "./canvas-presenter";
+import type { DelegatedEvent } from "./dom-patcher";
+import type { CompiledModule } from "./module-registry";
+import { type RenderScheduling, type WasmRuntimeHost, WasmRuntime } from "./wasm-runtime";
+
+// One side of a message channel: a Worker, the global scope inside of it, or a MessagePort, which
+// is also what worker_threads hands out in Node
+export type MessageEndpoint = {
+  postMessage(message: unknown, transfer: Transferable[]): void;
+  addEventListener(type: "message", listener: (event: MessageEvent) => void): void;
+  removeEventListener(type: "message", listener: (event: MessageEvent) => void): void;
+  start?(): void;
+};
+
+// Messages from the main thread to the worker. Events and scrolls carry the number of patches the
+// DOM had applied when they happened, their element indices are only valid for that render.
+export type WorkerRequest =
+  | { type: "init"; source: string | CompiledModule; snapshot?: Uint8Array; scheduling: RenderScheduling }
+  | { type: "render" }
+  | { type: "suspend" }
+  | { type: "resume"; scheduling: RenderScheduling }
+  | { type: "event"; frame: number; event: DelegatedEvent }
+  | { type: "scroll"; frame: number; index: number; scrollTop: number; viewportHeight: number }
+  | { type: "visibility"; visible: boolean; canvasId?: string }
+  | { type: "attach-canvas"; canvasId: string; node: number; canvas: OffscreenCanvas }
+  | { type: "update-canvas"; canvasId: string; node: number; width: number; height: number }
+  | { type: "detach-canvas"; canvasId: string; node: number }
+  | { type: "destroy" };
+
+// Messages from the worker to the main thread, the buffers of patches and pixels are transferred.
+// ready answers init and resume, with the number of renders so far.
+export type WorkerResponse =
+  | { type: "ready"; frame: number }
+  | { type: "error"; message: string }
+  | { type: "patch"; commands: Uint8Array; strings: string[] }
+  | { type: "canvas"; canvasId: string; pixels: Uint8ClampedArray; width: number; height: number; dirty?: Int32Array }
+  | { type: "snapshot"; blob: Uint8Array };
+
+// Runs a WasmRuntime behind endpoint. Only copies of the render commands and canvas pixels leave
+// the worker, wasm memory is never shared with the main thread. Canvases attached as OffscreenCanvas
+// are presented by the worker itself, their pixels do not leave it at all.
+export function serveWasmRuntime(endpoint: MessageEndpoint) {
+  let runtime: WasmRuntime | undefined;
+  // By canvas id, with the node of the canvas element they were transferred from
+  const canvases = new Map<string, { node: number; presenter: CanvasPresenter }>();
+
+  const post = (message: WorkerResponse, transfer: Transferable[] = []) => {
+    endpoint.postMessage(message, transfer);
+  };
+
+  const host: WasmRuntimeHost = {
+    patch: (commands, strings) => {
+      const copy = commands.slice();
+      post({ type: "patch", commands: copy, strings }, [copy.buffer]);
+    },
+    drawCanvas: (canvasId, pixels, width, height, stride, dirty) => {
+      const canvas = canvases.get(canvasId);
+      if (canvas) {
+        canvas.presenter.present(pixels, width, height, stride, dirty);
+        return;
+      }
+
+      // Only the pixels of the canvas are copied, not the rest of the rows of a subcanvas
+      const copy = packPixels(pixels, width, height, stride);
+      post({ type: "canvas", canvasId, pixels: copy, width, height, dirty: dirty?.slice() }, [copy.buffer]);
+    },
+    snapshot: (blob) => {
+      post({ type: "snapshot", blob }, [blob.buffer]);
+    },
+  };
+
+  endpoint.addEventListener("message", async (message: MessageEvent<WorkerRequest>) => {
+    const request = message.data;
+    switch (request.type) {
+      case "init": {
+        runtime = new WasmRuntime(request.source, host, {
+          scheduling: request.scheduling,
+          snapshot: request.snapshot,
+        });
+
+        try {
+          await runtime.init();
+        } catch (error) {
+          post({ type: "error", message: String(error) });
+          return;
+        }
+        post({ type: "ready", frame: runtime.frame });
+        break;
+      }
+
+      case "render":
+        runtime?.render();
+        break;
+
+      // The canvases of a suspended runtime are gone with its nodes, the next host attaches new ones
+      case "suspend":
+        runtime?.suspend();
+        canvases.clear();
+        break;
+
+      case "resume":
+        if (runtime) {
+          runtime.resume(host, request.scheduling);
+          post({ type: "ready", frame: runtime.frame });
+        }
+        break;
+
+      // Renders that the DOM has not caught up with yet invalidated the indices, the input is dropped
+      case "event":
+        if (runtime && request.frame === runtime.frame) {
+          runtime.dispatchEvent(request.event);
+        }
+        break;
+
+      case "scroll":
+        if (runtime && request.frame === runtime.frame) {
+          runtime.scroll(request.index, request.scrollTop, request.viewportHeight);
+        }
+        break;
+
+      // Canvas ids do not depend on the render, unlike element indices
+      case "visibility":
+        runtime?.setVisible(request.visible, request.canvasId);
+        break;
+
+      case "attach-canvas": {
+        const context = request.canvas.getContext("2d");
+        if (!context) {
+          post({ type: "error", message: "Failed to get offscreen canvas context" });
+          return;
+        }
+        canvases.set(request.canvasId, { node: request.node, presenter: new CanvasPresenter(context) });
+        break;
+      }
+
+      // The canvas is found by its node, its id may have changed
+      case "update-canvas":
+        for (const [canvasId, canvas] of canvases) {
+          if (canvas.node !== request.node) {
+            continue;
+          }
+          canvases.delete(canvasId);
+          canvases.set(request.canvasId, canvas);
+          canvas.presenter.resize(request.width, request.height);
+          break;
+        }
+        break;
+
+      // A canvas created again with the same id may already be attached
+      case "detach-canvas":
+        if (canvases.get(request.canvasId)?.node === request.node) {
+          canvases.delete(request.canvasId);
+        }
+        break;
+
+      case "destroy":
+        runtime?.destroy();
+        runtime = undefined;
+        canvases.clear();
+        break;
+    }
+  });
+  endpoint.start?.();
+}
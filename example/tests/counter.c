@@ -0,0 +1,19 @@
+#include "sandor.h"
+
+// A button that counts its clicks, for worker.test.mjs
+int count = 0;
+
+bool increment(void* args)
+{
+    (void)args;
+    count++;
+    return true;
+}
+
+Element* render_component()
+{
+    return element("div", children(
+        button("Add", increment, NULL),
+        text_element("p", arena_sprintf(&r_arena, "count %d", count))
+    ));
+}
@@ -0,0 +1,266 @@
+// Just enough of the DOM for DomPatcher to run in Node: a node tree with attributes and text,
+// events that bubble through it and observers that only report what a test tells them to.
+// Importing it installs the globals.
+
+class ShimNode {
+  parentNode = null;
+  childNodes = [];
+  #listeners = new Map();
+
+  get parentElement() {
+    return this.parentNode instanceof HTMLElement ? this.parentNode : null;
+  }
+
+  get firstChild() {
+    return this.childNodes[0] ?? null;
+  }
+
+  get isConnected() {
+    let node = this;
+    while (node.parentNode) {
+      node = node.parentNode;
+    }
+    return node === document.body;
+  }
+
+  get textContent() {
+    return this.childNodes.map((child) => child.textContent).join("");
+  }
+
+  set textContent(text) {
+    for (const child of [...this.childNodes]) {
+      child.remove();
+    }
+    this.appendChild(document.createTextNode(text));
+  }
+
+  appendChild(node) {
+    return this.insertBefore(node, null);
+  }
+
+  insertBefore(node, before) {
+    node.remove();
+    const index = before === null ? this.childNodes.length : this.childNodes.indexOf(before);
+    if (index < 0) {
+      throw new Error("The node before which to insert is not a child of this node");
+    }
+    this.childNodes.splice(index, 0, node);
+    node.parentNode = this;
+    return node;
+  }
+
+  remove() {
+    if (this.parentNode) {
+      this.parentNode.childNodes.splice(this.parentNode.childNodes.indexOf(this), 1);
+      this.parentNode = null;
+    }
+  }
+
+  addEventListener(type, listener) {
+    const listeners = this.#listeners.get(type) ?? [];
+    listeners.push(listener);
+    this.#listeners.set(type, listeners);
+  }
+
+  removeEventListener(type, listener) {
+    const listeners = this.#listeners.get(type) ?? [];
+    this.#listeners.set(type, listeners.filter((other) => other !== listener));
+  }
+
+  // Bubbles to the root of the tree, every event does
+  dispatchEvent(event) {
+    event.target = this;
+    for (let node = this; node; node = node.parentNode) {
+      for (const listener of node.#listeners.get(event.type) ?? []) {
+        listener(event);
+      }
+    }
+    return true;
+  }
+}
+
+class Text extends ShimNode {
+  constructor(data) {
+    super();
+    this.data = data;
+  }
+
+  get textContent() {
+    return this.data;
+  }
+}
+
+class HTMLElement extends ShimNode {
+  attributes = new Map();
+  dataset = {};
+  style = {};
+  classList = {
+    add: (...names) => this.setAttribute("class", [this.getAttribute("class") ?? "", ...names].join(" ").trim()),
+  };
+  scrollTop = 0;
+  clientHeight = 0;
+
+  constructor(tagName) {
+    super();
+    this.tagName = tagName.toUpperCase();
+  }
+
+  get id() {
+    return this.getAttribute("id") ?? "";
+  }
+
+  set id(id) {
+    this.setAttribute("id", id);
+  }
+
+  get children() {
+    return this.childNodes.filter((child) => child instanceof HTMLElement);
+  }
+
+  getAttribute(name) {
+    return this.attributes.get(name) ?? null;
+  }
+
+  setAttribute(name, value) {
+    this.attributes.set(name, String(value));
+  }
+
+  removeAttribute(name) {
+    this.attributes.delete(name);
+  }
+
+  getBoundingClientRect() {
+    return { left: 0, top: 0, width: 0, height: 0 };
+  }
+
+  // Descendants in document order, selected by "*", "#id" or a tag name
+  querySelectorAll(selector) {
+    const matches = (element) =>
+      selector === "*" ||
+      (selector.startsWith("#") ? element.id === selector.slice(1) : element.tagName === selector.toUpperCase());
+    const found = [];
+    const visit = (element) => {
+      for (const child of element.children) {
+        if (matches(child)) {
+          found.push(child);
+        }
+        visit(child);
+      }
+    };
+    visit(this);
+    return found;
+  }
+
+  querySelector(selector) {
+    return this.querySelectorAll(selector)[0] ?? null;
+  }
+}
+
+class HTMLInputElement extends HTMLElement {
+  value = "";
+}
+
+// Canvases have no 2d context here, presenting into one only logs an error
+class HTMLCanvasElement extends HTMLElement {
+  getContext() {
+    return null;
+  }
+}
+
+// Has the properties of every kind of event the patcher reads, init overrides them
+class ShimEvent {
+  target = null;
+  clientX = 0;
+  clientY = 0;
+  key = "";
+  shiftKey = false;
+  ctrlKey = false;
+  altKey = false;
+  metaKey = false;
+  deltaX = 0;
+  deltaY = 0;
+  deltaMode = 0;
+
+  constructor(type, init = {}) {
+    this.type = type;
+    Object.assign(this, init);
+  }
+}
+
+class MouseEvent extends ShimEvent {}
+
+class KeyboardEvent extends ShimEvent {}
+
+class WheelEvent extends MouseEvent {
+  static DOM_DELTA_PIXEL = 0;
+  static DOM_DELTA_LINE = 1;
+  static DOM_DELTA_PAGE = 2;
+}
+
+// Every observer created so far, a test reports intersections through them
+export const intersectionObservers = [];
+
+class IntersectionObserver {
+  observed = new Set();
+
+  constructor(callback) {
+    this.callback = callback;
+    intersectionObservers.push(this);
+  }
+
+  observe(element) {
+    this.observed.add(element);
+  }
+
+  unobserve(element) {
+    this.observed.delete(element);
+  }
+
+  disconnect() {
+    this.observed.clear();
+  }
+}
+
+class ResizeObserver {
+  observe() {}
+  unobserve() {}
+  disconnect() {}
+}
+
+// Reports element in or out of view to the observers watching it, as the browser does after layout
+export function reportIntersection(element, isIntersecting) {
+  for (const observer of intersectionObservers) {
+    if (observer.observed.has(element)) {
+      observer.callback([{ target: element, isIntersecting }]);
+    }
+  }
+}
+
+const elementClasses = { input: HTMLInputElement, canvas: HTMLCanvasElement };
+
+const document = Object.assign(new ShimNode(), {
+  baseURI: "file:///",
+  visibilityState: "visible",
+  body: new HTMLElement("body"),
+  createElement: (tagName) => new (elementClasses[tagName] ?? HTMLElement)(tagName),
+  createTextNode: (data) => new Text(data),
+});
+
+Object.assign(globalThis, {
+  document,
+  window: globalThis,
+  Text,
+  HTMLElement,
+  HTMLInputElement,
+  HTMLCanvasElement,
+  MouseEvent,
+  KeyboardEvent,
+  WheelEvent,
+  IntersectionObserver,
+  ResizeObserver,
+});
+
+// Clicks element the way a user would, the event bubbles up to the delegated listeners
+export function click(element) {
+  element.dispatchEvent(new MouseEvent("click"));
+}
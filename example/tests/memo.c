@@ -0,0 +1,36 @@
+#include "sandor.h"
+
+// Renders the steps of memo.test.mjs, one per render. The inner subtree is memoized inside the
+// outer one and only part of it while the outer dependency is 1.
+int outer_steps[] = { 1, 2, 2, 1 };
+int render_count = 0;
+
+Element* render_inner(const void* deps)
+{
+    (void)deps;
+    return text_element("span", "inner");
+}
+
+Element* render_outer(const void* deps)
+{
+    int outer = *(const int*)deps;
+    if (outer != 1) {
+        return element("div", children(text_element("p", arena_sprintf(&r_arena, "outer %d", outer))));
+    }
+
+    int inner = 0;
+    return element("div", children(
+        text_element("p", arena_sprintf(&r_arena, "outer %d", outer)),
+        memo("inner", &inner, sizeof(inner), render_inner)
+    ));
+}
+
+Element* render_component()
+{
+    size_t step = render_count < 4 ? render_count : 3;
+    render_count++;
+
+    return element("div", children(
+        memo("outer", &outer_steps[step], sizeof(outer_steps[step]), render_outer)
+    ));
+}
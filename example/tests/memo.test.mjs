@@ -0,0 +1,15 @@
+import assert from "node:assert/strict";
+import { test } from "node:test";
+import { mountApp } from "./wasm-app.mjs";
+
+// The outer subtree is rendered without the inner one in the second render and reused in the third.
+// The inner slot must not count as reused from the frame before when it comes back in the fourth,
+// its nodes were removed in the second.
+test("nested memo that is left out and comes back is created again", async () => {
+  const { parent, runtime } = await mountApp("memo");
+  const expected = ["outer 1inner", "outer 2", "outer 2", "outer 1inner"];
+  for (const text of expected) {
+    runtime.render();
+    assert.equal(parent.textContent, text);
+  }
+});
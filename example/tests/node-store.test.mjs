@@ -0,0 +1,25 @@
+import assert from "node:assert/strict";
+import { test } from "node:test";
+import { NODE_NONE } from "../src/wasm-runtime.ts";
+import { mountApp } from "./wasm-app.mjs";
+
+// Text of the subtree of id, read through the typed-array views of the store
+function storeText(runtime, store, id) {
+  let text = store.text[id] === 0 ? "" : runtime.memory.readString(store.text[id]);
+  for (let child = store.firstChild[id]; child !== NODE_NONE; child = store.nextSibling[child]) {
+    text += storeText(runtime, store, child);
+  }
+  return text;
+}
+
+test("node store of every render mirrors the DOM", async () => {
+  const { parent, patcher, runtime } = await mountApp("memo");
+  for (let i = 0; i < 4; i++) {
+    runtime.render();
+    const store = runtime.readNodeStore();
+    assert.equal(storeText(runtime, store, 0), parent.textContent);
+    for (let id = 0; id < store.count; id++) {
+      assert.ok(patcher.nodes.has(store.node[id]), `node ${store.node[id]} of ${id} is live`);
+    }
+  }
+});
@@ -0,0 +1,13 @@
+// Lets Node run the TypeScript sources of src directly, Node 22.18 or newer strips their types.
+// Their imports leave out the extension, the bundler resolves them to the .ts files.
+import { registerHooks } from "node:module";
+
+registerHooks({
+  resolve(specifier, context, nextResolve) {
+    const relative = specifier.startsWith("./") || specifier.startsWith("../");
+    if (relative && context.parentURL?.endsWith(".ts") && !/\.[cm]?[jt]s$/.test(specifier)) {
+      return nextResolve(`${specifier}.ts`, context);
+    }
+    return nextResolve(specifier, context);
+  },
+});
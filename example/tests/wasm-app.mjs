@@ -0,0 +1,34 @@
+import "./dom-shim.mjs";
+import { readFile } from "node:fs/promises";
+import { DomPatcher } from "../src/dom-patcher.ts";
+import { hashModule } from "../src/memory-snapshot.ts";
+import { WasmRuntime } from "../src/wasm-runtime.ts";
+
+// Compiles a module built by ./nob test, name is the C file in tests without its extension
+export async function compileTestModule(name) {
+  const bytes = await readFile(new URL(`./build/${name}.wasm`, import.meta.url));
+  return { module: await WebAssembly.compile(bytes), hash: await hashModule(bytes) };
+}
+
+// Runs the module on the main thread of the shim, every render is applied to the DOM right away
+export async function mountApp(name) {
+  const source = await compileTestModule(name);
+  const parent = document.createElement("div");
+  document.body.appendChild(parent);
+
+  const patcherHost = {
+    dispatchEvent: (event) => runtime.dispatchEvent(event),
+    scroll: (index, scrollTop, viewportHeight) => runtime.scroll(index, scrollTop, viewportHeight),
+    render: () => runtime.render(),
+    setVisible: (visible, canvasId) => runtime.setVisible(visible, canvasId),
+  };
+  const patcher = new DomPatcher(parent, patcherHost, name);
+  const runtimeHost = {
+    patch: (commands, strings) => patcher.applyRenderCommands(commands, 0, commands.length, strings),
+    drawCanvas: (canvasId, pixels, width, height, stride, dirty) =>
+      patcher.drawCanvas(canvasId, pixels, width, height, stride, dirty),
+  };
+  const runtime = new WasmRuntime(source, runtimeHost, { scheduling: "sync" });
+  await runtime.init();
+  return { parent, patcher, runtime };
+}
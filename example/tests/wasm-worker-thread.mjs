@@ -0,0 +1,5 @@
+import { workerData } from "node:worker_threads";
+import { serveWasmRuntime } from "../src/wasm-worker.ts";
+
+// Runs the runtime of worker.test.mjs on the port it was handed, as wasm-worker-entry.ts does on self
+serveWasmRuntime(workerData.port);
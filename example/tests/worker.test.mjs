@@ -0,0 +1,54 @@
+import assert from "node:assert/strict";
+import { test } from "node:test";
+import { MessageChannel, Worker } from "node:worker_threads";
+import { click } from "./dom-shim.mjs";
+import { compileTestModule } from "./wasm-app.mjs";
+import { WasmWorkerComponent } from "../src/wasm-worker-component.ts";
+
+// Resolves once the component has applied a patch it has not applied yet
+async function nextPatch(component) {
+  const frame = component.frame;
+  while (component.frame === frame) {
+    await new Promise((resolve) => setImmediate(resolve));
+  }
+}
+
+// The runtime runs in a worker thread and talks to the component over a MessagePort, the way it
+// talks to the main thread of a browser. The worker inherits --import, so it can load src as well.
+test("component renders and handles events through a worker", { timeout: 10000 }, async () => {
+  const { port1, port2 } = new MessageChannel();
+  const worker = new Worker(new URL("./wasm-worker-thread.mjs", import.meta.url), {
+    workerData: { port: port2 },
+    transferList: [port2],
+  });
+
+  const module = await compileTestModule("counter");
+  const component = new WasmWorkerComponent("counter.wasm", { endpoint: port1, module, scheduling: "microtask" });
+  const parent = document.createElement("div");
+  document.body.appendChild(parent);
+
+  try {
+    await component.init(parent);
+    component.render();
+    await nextPatch(component);
+    assert.equal(parent.textContent, "Addcount 0");
+
+    const button = parent.querySelector("button");
+    assert.notEqual(button.dataset.sandorEvents, undefined);
+
+    // The second click leaves before the patch of the first arrives, the worker has rendered since
+    // and drops it as stale
+    click(button);
+    click(button);
+    await nextPatch(component);
+    assert.equal(parent.textContent, "Addcount 1");
+
+    click(button);
+    await nextPatch(component);
+    assert.equal(parent.textContent, "Addcount 2");
+  } finally {
+    component.destroy();
+    port1.close();
+    await worker.terminate();
+  }
+});
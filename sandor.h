@@ -31,21 +31,112 @@
 #define OLIVEC_IMPLEMENTATION
 #include "olive.c"
 
-void platform_write(void *buffer, size_t len);
+// Logging
+//
+// Messages are formatted into a ring buffer in linear memory instead of calling into the host for
+// each of them. The host drains the ring once per frame, when it fills up and before a trap is
+// reported. Every message is a level byte followed by its text and a NUL. Messages longer than the
+// ring stream through it in chunks, the host reassembles them.
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+// Messages below this level are compiled out, their arguments are not even evaluated
+#ifndef SANDOR_LOG_LEVEL
+#define SANDOR_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Must be a power of two
+#define LOG_RING_CAPACITY (16 * 1024)
+
+// head and tail count every byte written and drained, they wrap around at 2^32
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t capacity;
+    char* items;
+} LogRing;
+
+char r_log_items[LOG_RING_CAPACITY];
+LogRing r_log = { .capacity = LOG_RING_CAPACITY, .items = r_log_items };
+
+// Asks the host to drain the ring right away
+void platform_flush_log();
+
+[[clang::export_name("get_log_ring")]]
+LogRing* get_log_ring() {
+    return &r_log;
+}
+
+void log_write(const char* bytes, size_t len)
+{
+    while (len > 0) {
+        uint32_t available = r_log.capacity - (r_log.head - r_log.tail);
+        if (available == 0) {
+            platform_flush_log();
+            continue;
+        }
+
+        uint32_t offset = r_log.head & (r_log.capacity - 1);
+        uint32_t n = r_log.capacity - offset;
+        if (n > available) n = available;
+        if (n > len) n = len;
+
+        for (uint32_t i = 0; i < n; i++) {
+            r_log.items[offset + i] = bytes[i];
+        }
+        r_log.head += n;
+        bytes += n;
+        len -= n;
+    }
+}
+
+char* log_write_chunk(const char* buf, void* user, int len)
+{
+    (void)user;
+    log_write(buf, len);
+    return (char*)buf;
+}
 
-#define WRITE_BUFFER_CAPACITY 4096
-char write_buffer[WRITE_BUFFER_CAPACITY];
+int sandor_vlog(int level, const char* fmt, va_list args)
+{
+    char level_byte = level;
+    log_write(&level_byte, 1);
+
+    char chunk[STB_SPRINTF_MIN];
+    int n = stbsp_vsprintfcb(log_write_chunk, NULL, chunk, fmt, args);
+
+    log_write("", 1);
+    return n;
+}
+
+int sandor_log(int level, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = sandor_vlog(level, fmt, args);
+    va_end(args);
+    return n;
+}
+
+#define log_debug(...) (SANDOR_LOG_LEVEL <= LOG_LEVEL_DEBUG ? sandor_log(LOG_LEVEL_DEBUG, __VA_ARGS__) : 0)
+#define log_info(...) (SANDOR_LOG_LEVEL <= LOG_LEVEL_INFO ? sandor_log(LOG_LEVEL_INFO, __VA_ARGS__) : 0)
+#define log_warn(...) (SANDOR_LOG_LEVEL <= LOG_LEVEL_WARN ? sandor_log(LOG_LEVEL_WARN, __VA_ARGS__) : 0)
+#define log_error(...) (SANDOR_LOG_LEVEL <= LOG_LEVEL_ERROR ? sandor_log(LOG_LEVEL_ERROR, __VA_ARGS__) : 0)
+
+// printf logs at the info level
 int printf(const char *fmt, ...)
 {
     va_list args;
     va_start(args, fmt);
-    int n = stbsp_vsnprintf(write_buffer, WRITE_BUFFER_CAPACITY, fmt, args);
+    int n = SANDOR_LOG_LEVEL <= LOG_LEVEL_INFO ? sandor_vlog(LOG_LEVEL_INFO, fmt, args) : 0;
     va_end(args);
-    platform_write(write_buffer, n);
     return n;
 }
 
-#define ASSERT(cond) (!(cond) ? printf("%s:%d: %s: Assertion `%s' failed.", __FILE__, __LINE__, __func__, #cond), __builtin_trap() : 0)
+// The failed assertion is logged regardless of SANDOR_LOG_LEVEL and flushed before trapping
+#define ASSERT(cond) (!(cond) ? sandor_log(LOG_LEVEL_ERROR, "%s:%d: %s: Assertion `%s' failed.", __FILE__, __LINE__, __func__, #cond), platform_flush_log(), __builtin_trap() : 0)
 
 #define ARENA_ASSERT(cond) ASSERT(cond)
 #define ARENA_IMPLEMENTATION
@@ -53,6 +144,30 @@ int printf(const char *fmt, ...)
 #define ARENA_BACKEND ARENA_BACKEND_WASM_HEAPBASE
 #include "arena.h"
 
+bool str_eq(const char* a, const char* b)
+{
+    if (a == b) return true;
+    if (a == NULL || b == NULL) return false;
+
+    while (*a != '\0' && *a == *b) {
+        a++;
+        b++;
+    }
+
+    return *a == *b;
+}
+
+uint32_t str_hash(const char* s)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*s != '\0') {
+        hash ^= (uint8_t)*s++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 void copy(const char *src, char *dst, size_t max_len) {
     size_t i = 0;
 
@@ -67,21 +182,25 @@ void copy(const char *src, char *dst, size_t max_len) {
 
 typedef struct Element Element;
 
+// Sized to fit when created, so the common case never goes through arena_da_append growth
 typedef struct {
     size_t count;
     size_t capacity;
     Element** items;
 } Children;
 
+// Ids are the interned ids of name and value, 0 if they are not interned
 typedef struct {
     const char* name;
     const char* value;
+    uint32_t name_id;
+    uint32_t value_id;
 } Attribute;
 
+// All attributes of an element in one contiguous block
 typedef struct {
     size_t count;
-    size_t capacity;
-    Attribute** items;
+    Attribute* items;
 } Attributes;
 
 typedef enum {
@@ -89,20 +208,67 @@ typedef enum {
     ELEMENT_BUTTON = 1,
     ELEMENT_INPUT = 2,
     ELEMENT_CANVAS = 3,
+    ELEMENT_VIRTUAL_LIST = 4,
 } ElementType;
 
 typedef struct {
     const char* tag;
+    uint32_t tag_id;
 } GenericElement;
 
+// Bubbling events the host delegates to wasm, in the order of the host's delegated events
+typedef enum {
+    EVENT_CLICK = 0,
+    EVENT_CHANGE = 1,
+    EVENT_INPUT = 2,
+    EVENT_KEYDOWN = 3,
+    EVENT_KEYUP = 4,
+    EVENT_POINTERDOWN = 5,
+    EVENT_POINTERMOVE = 6,
+    EVENT_POINTERUP = 7,
+    EVENT_WHEEL = 8,
+} EventType;
+
+#define MODIFIER_SHIFT 1
+#define MODIFIER_CTRL 2
+#define MODIFIER_ALT 4
+#define MODIFIER_META 8
+
+typedef struct {
+    EventType type;
+    // Value of the input for change and input events, the key for key events, NULL otherwise
+    const char* value;
+    // Pointer position relative to the element the listener is on
+    int32_t x;
+    int32_t y;
+    // Scroll amount of wheel events in pixels, 0 otherwise
+    int32_t delta_x;
+    int32_t delta_y;
+    uint32_t modifiers;
+} Event;
+
+// Event handlers return true when they changed state that affects rendering
+typedef bool (*EventHandler)(const Event* event, void* args);
+
+typedef struct {
+    EventType type;
+    EventHandler handler;
+    void* args;
+} Listener;
+
 typedef struct {
-    void (*on_click)(void*);
+    size_t count;
+    Listener* items;
+} Listeners;
+
+typedef struct {
+    bool (*on_click)(void*);
     void* on_click_args;
 } ButtonElement;
 
 typedef struct {
     char* placeholder;
-    void (*on_change)(const char*);
+    bool (*on_change)(const char*);
 } InputElement;
 
 typedef struct {
@@ -111,14 +277,32 @@ typedef struct {
     size_t height;
 } CanvasElement;
 
+// Only rows [first, last) are children of the element
+typedef struct {
+    size_t count;
+    size_t row_height;
+    size_t first;
+    size_t last;
+    // Slot of the scroll state reported by the host
+    size_t state;
+} VirtualListElement;
+
 struct Element {
     ElementType type;
     size_t index;
+    // Id of the host node backing this element, assigned by the diff and kept across renders
+    size_t node;
+    // Memo slot + 1 for roots of memoized subtrees, 0 otherwise
+    size_t memo;
+    // Id in the NodeStore of the last frame that rendered the element
+    uint32_t id;
     
     // Common properties for all elements
+    const char* key;
     char* text;
     Children* children;
     Attributes* attributes;
+    Listeners* listeners;
     
     // Type-specific data
     union {
@@ -126,6 +310,7 @@ struct Element {
         ButtonElement button;
         InputElement input;
         CanvasElement canvas;
+        VirtualListElement virtual_list;
     };
 };
 
@@ -144,20 +329,216 @@ typedef struct {
     } 
 
 void platform_rerender();
+void platform_render_now();
+// Presents the pixels of canvas, which can be a subcanvas: several DOM canvases can show parts of
+// one framebuffer without copying it. If it tracks dirty rects (olivec_track_dirty), only those are
+// uploaded. The host clears them when the callback that presented them returns, so all the
+// subcanvases of a framebuffer should be presented from the same callback.
 void platform_draw_canvas(char* canvas_id, Olivec_Canvas* canvas);
+// callback runs on every display frame until it is cleared, see pace_animation_frame() for others
 void platform_on_animation_frame(void (*callback)(float dt));
 void platform_clear_animation_frame(void (*callback)(float dt));
 
+// Frames are double-buffered: frame N is built in r_arena and r_elements while frame N-1 stays
+// readable in r_prev_arena and r_prev_elements until the next render starts.
 Arena r_arena = {0};
 Elements r_elements = {0};
+Element* r_root = NULL;
+
+Arena r_prev_arena = {0};
+Elements r_prev_elements = {0};
+Element* r_prev_root = NULL;
+
+// Incremented by every render, 0 means nothing was rendered yet
+size_t r_frame = 0;
+
+// Element indices encode the table an element is registered in above MEMO_INDEX_SHIFT:
+// 0 is the frame table r_elements, n is the table of memo slot n - 1
+#define MEMO_INDEX_SHIFT 24
+size_t r_index_base = 0;
+
+size_t next_element_index()
+{
+    ASSERT(r_elements.count < ((size_t)1 << MEMO_INDEX_SHIFT));
+    return r_index_base + r_elements.count;
+}
+
+// Set when state that affects rendering changed since the last render
+bool r_dirty = false;
+// Set once the host was asked for a render, further invalidations are folded into that one
+bool r_render_requested = false;
+
+// Marks the component as needing a render, use it for state changes outside of event handlers
+void sandor_invalidate()
+{
+    r_dirty = true;
+}
+
+// Asks the host to schedule a render only if something was invalidated, called after every entry
+// point from the host. The host coalesces requests into one render per frame.
+void flush_invalidations()
+{
+    if (r_dirty && !r_render_requested) {
+        r_render_requested = true;
+        platform_rerender();
+    }
+}
+
+// Opt-in synchronous render for when the DOM has to reflect the new state before returning
+void sandor_flush()
+{
+    if (r_dirty) {
+        platform_render_now();
+    }
+}
+
+// Element tables keep their storage across frames and only grow, so swapping them never reallocates
+Arena r_tables_arena = {0};
+
+// Promotes the current frame to the previous one and recycles the frame before it for building
+void begin_frame()
+{
+    Arena arena = r_prev_arena;
+    r_prev_arena = r_arena;
+    r_arena = arena;
+    arena_reset(&r_arena);
+
+    Elements elements = r_prev_elements;
+    r_prev_elements = r_elements;
+    r_elements = elements;
+    r_elements.count = 0;
+
+    r_prev_root = r_root;
+    r_root = NULL;
+    r_frame++;
+
+    r_dirty = false;
+    r_render_requested = false;
+}
+
+// Root of the previous frame, NULL before the second render
+Element* prev_root()
+{
+    return r_prev_root;
+}
 
 _init_struct(Element);
-_init_struct(Attribute);
 _init_struct(Children);
 _init_struct(Attributes);
 
+// String interning
+//
+// Tags, attribute names and attribute values mostly repeat from render to render. They are copied
+// once into a table that lives as long as the module and get stable ids, so elements point at the
+// interned copy instead of duplicating it every render, the diff compares ids and the host decodes
+// every interned string only once. Once the table is full, new strings are copied per frame again.
+#define INTERN_CAPACITY 1024
+#define INTERN_TABLE_SIZE (INTERN_CAPACITY * 2)
+#define INTERN_SEEN_SIZE 1024
+
+typedef struct {
+    const char* value;
+    uint32_t length;
+    uint32_t hash;
+    // Whether the host already cached the string under its id
+    bool sent;
+} InternedString;
+
+// Indexed by id, id 0 is never used
+InternedString r_interned[INTERN_CAPACITY + 1] = {0};
+size_t r_interned_count = 0;
+// Open addressing table from hash to id, 0 marks an empty slot
+uint32_t r_intern_table[INTERN_TABLE_SIZE] = {0};
+Arena r_intern_arena = {0};
+
+// Strings that are not static are only interned once they come back in a later render, values that
+// change every render (counters, generated ids) would otherwise fill the table for good. Candidates
+// are remembered by hash with the render they were seen in, a colliding one replaces them.
+typedef struct {
+    uint32_t hash;
+    size_t frame;
+} InternCandidate;
+
+InternCandidate r_intern_seen[INTERN_SEEN_SIZE] = {0};
+
+// Static strings are referenced in place instead of being copied into the table
+uint32_t _intern(const char* value, bool is_static)
+{
+    if (value == NULL) {
+        return 0;
+    }
+
+    uint32_t hash = str_hash(value);
+    size_t slot = hash & (INTERN_TABLE_SIZE - 1);
+    while (r_intern_table[slot] != 0) {
+        InternedString* interned = &r_interned[r_intern_table[slot]];
+        if (interned->hash == hash && str_eq(interned->value, value)) {
+            return r_intern_table[slot];
+        }
+        slot = (slot + 1) & (INTERN_TABLE_SIZE - 1);
+    }
+
+    if (r_interned_count == INTERN_CAPACITY) {
+        return 0;
+    }
+
+    if (!is_static) {
+        InternCandidate* seen = &r_intern_seen[hash & (INTERN_SEEN_SIZE - 1)];
+        if (seen->hash != hash || seen->frame == r_frame) {
+            *seen = (InternCandidate) { .hash = hash, .frame = r_frame };
+            return 0;
+        }
+    }
+
+    uint32_t id = ++r_interned_count;
+    size_t length = arena_strlen(value);
+    r_interned[id] = (InternedString) {
+        .value = is_static ? value : arena_memdup(&r_intern_arena, (void*)value, length + 1),
+        .length = length,
+        .hash = hash,
+        .sent = false,
+    };
+    r_intern_table[slot] = id;
+
+    return id;
+}
+
+// Returns the stable id of value, 0 if value is NULL, the table is full or value was not seen in an
+// earlier render yet
+uint32_t intern(const char* value)
+{
+    return _intern(value, false);
+}
+
+// The interned copy of value, or a copy in the frame arena if it cannot be interned
+const char* intern_or_copy(const char* value, uint32_t* id)
+{
+    *id = intern(value);
+    if (*id != 0) {
+        return r_interned[*id].value;
+    }
+    return value ? arena_strdup(&r_arena, value) : NULL;
+}
+
+// Like intern_or_copy() for static strings, which are never copied
+const char* intern_static(const char* value, uint32_t* id)
+{
+    *id = _intern(value, true);
+    if (*id != 0) {
+        return r_interned[*id].value;
+    }
+    return value;
+}
+
+bool interned_eq(const char* a, uint32_t a_id, const char* b, uint32_t b_id)
+{
+    if (a_id != 0 && b_id != 0) {
+        return a_id == b_id;
+    }
+    return str_eq(a, b);
+}
+
 #define ELEMENT(...) _init_Element(struct_wrapper(Element, __VA_ARGS__))
-#define ATTRIBUTE(...) _init_Attribute(struct_wrapper(Attribute, __VA_ARGS__))
 #define CHILDREN(...) _init_Children(struct_wrapper(Children, __VA_ARGS__))
 #define ATTRIBUTES(...) _init_Attributes(struct_wrapper(Attributes, __VA_ARGS__))
 
@@ -183,42 +564,64 @@ char *arena_sprintf(Arena* a, const char *format, ...)
 
 Children* _children(size_t count, ...) {
     Children* result = CHILDREN({
-        .count = 0,
-        .capacity = 0,
-        .items = NULL
+        .count = count,
+        .capacity = count,
+        .items = count > 0 ? arena_alloc(&r_arena, count * sizeof(Element*)) : NULL
     });
 
     va_list args;
     va_start(args, count);
     for (size_t i = 0; i < count; i++) {
-        Element* element = va_arg(args, Element*);
-        arena_da_append(&r_arena, result, element);
+        result->items[i] = va_arg(args, Element*);
     }
     va_end(args);
 
     return result;
 }
 
+// Grows geometrically from a small capacity instead of the ARENA_DA_INIT_CAP of arena_da_append
+void children_reserve(Children* children, size_t count)
+{
+    if (count <= children->capacity) {
+        return;
+    }
+
+    size_t capacity = children->capacity < 4 ? 4 : children->capacity * 2;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    children->items = arena_realloc(&r_arena, children->items, children->capacity * sizeof(Element*), capacity * sizeof(Element*));
+    children->capacity = capacity;
+}
+
 #define add_children(parent, ...) _add_children(parent, _NARG(__VA_ARGS__), __VA_ARGS__)
 void _add_children(Element* parent, size_t count, ...) {
+    Children* children = parent->children;
+    children_reserve(children, children->count + count);
+
     va_list args;
     va_start(args, count);
     for (size_t i = 0; i < count; i++) {
-        Element* element = va_arg(args, Element*);
-        arena_da_append(&r_arena, parent->children, element);
+        children->items[children->count++] = va_arg(args, Element*);
     }
     va_end(args);
 };
 
-#define attributes(element, ...) _attributes(element, _NARG(__VA_ARGS__), __VA_ARGS__)
-#define class(element, value) _attributes(element, 2, "class", value)
-Element* _attributes(Element* element, size_t count, ...) {
+// Static strings are string literals or other data that outlives every render and never changes,
+// the *_static variants reference them in place instead of copying them into r_arena. The diff and
+// the interning table take the same pointer for the same string, so a buffer that is written to
+// after it was passed here never updates in the DOM: use the copying variants for those.
+#define attributes(element, ...) _attributes(element, false, _NARG(__VA_ARGS__), __VA_ARGS__)
+#define attributes_static(element, ...) _attributes(element, true, _NARG(__VA_ARGS__), __VA_ARGS__)
+#define class(element, value) _attributes(element, false, 2, "class", value)
+#define class_static(element, value) _attributes(element, true, 2, "class", value)
+Element* _attributes(Element* element, bool is_static, size_t count, ...) {
     ASSERT(count % 2 == 0);
 
     element->attributes = ATTRIBUTES({
-        .count = 0,
-        .capacity = 0,
-        .items = NULL
+        .count = count / 2,
+        .items = arena_alloc(&r_arena, count / 2 * sizeof(Attribute))
     });
 
     va_list args;
@@ -227,40 +630,88 @@ Element* _attributes(Element* element, size_t count, ...) {
         const char* name = va_arg(args, const char*);
         const char* value = va_arg(args, const char*);
         
-        Attribute* attribute = ATTRIBUTE({
-            .name = arena_strdup(&r_arena, name),
-            .value = arena_strdup(&r_arena, value)
-        });
-        arena_da_append(&r_arena, element->attributes, attribute);
+        Attribute* attribute = &element->attributes->items[i];
+        if (is_static) {
+            attribute->name = intern_static(name, &attribute->name_id);
+            attribute->value = intern_static(value, &attribute->value_id);
+        } else {
+            attribute->name = intern_or_copy(name, &attribute->name_id);
+            attribute->value = intern_or_copy(value, &attribute->value_id);
+        }
     }
     va_end(args);
 
     return element;
 }
 
-Element* element(const char* tag, Children* children)
+// Keyed children are matched by key instead of position when diffing, use it for reorderable lists
+Element* key(Element* element, const char* value)
+{
+    element->key = arena_strdup(&r_arena, value);
+    return element;
+}
+
+// Value of an input. The diff compares it to what was typed into the input last, the host input is
+// set whenever they differ, e.g. when the application clears the value it renders.
+Element* value(Element* element, const char* text)
+{
+    ASSERT(element->type == ELEMENT_INPUT);
+    element->text = arena_strdup(&r_arena, text);
+    return element;
+}
+
+// Listens to a bubbling event on any element, events of its descendants included
+Element* on(Element* element, EventType type, EventHandler handler, void* args)
+{
+    Listeners* listeners = element->listeners;
+    if (listeners == NULL) {
+        listeners = element->listeners = arena_alloc(&r_arena, sizeof(Listeners));
+        *listeners = (Listeners) { .count = 0, .items = NULL };
+    }
+
+    listeners->items = arena_realloc(&r_arena, listeners->items, listeners->count * sizeof(Listener), (listeners->count + 1) * sizeof(Listener));
+    listeners->items[listeners->count++] = (Listener) { .type = type, .handler = handler, .args = args };
+
+    return element;
+}
+
+Element* _element(const char* tag, bool is_static, Children* children)
 {
+    uint32_t tag_id;
+    const char* interned_tag = is_static ? intern_static(tag, &tag_id) : intern_or_copy(tag, &tag_id);
+
     Element* result = ELEMENT({
         .type = ELEMENT_GENERIC,
-        .index = r_elements.count,
+        .index = next_element_index(),
         .text = NULL,
         .children = children,
         .attributes = NULL,
         .generic = {
-            .tag = arena_strdup(&r_arena, tag)
+            .tag = interned_tag,
+            .tag_id = tag_id
         }
     });
 
-    arena_da_append(&r_arena, &r_elements, result);
+    arena_da_append(&r_tables_arena, &r_elements, result);
 
     return result;
 }
 
-Element* button(char* text, void (*callback)(void*), void* args)
+Element* element(const char* tag, Children* children)
+{
+    return _element(tag, false, children);
+}
+
+Element* element_static(const char* tag, Children* children)
+{
+    return _element(tag, true, children);
+}
+
+Element* button(char* text, bool (*callback)(void*), void* args)
 {
     Element* result = ELEMENT({
         .type = ELEMENT_BUTTON,
-        .index = r_elements.count,
+        .index = next_element_index(),
         .text = text,
         .children = children_empty(),
         .attributes = NULL,
@@ -270,51 +721,60 @@ Element* button(char* text, void (*callback)(void*), void* args)
         }
     });
 
-    arena_da_append(&r_arena, &r_elements, result);
+    arena_da_append(&r_tables_arena, &r_elements, result);
 
     return result;
 }
 
-Element* input(const char* placeholder, void (*on_change)(const char*))
+Element* _input(const char* placeholder, bool is_static, bool (*on_change)(const char*))
 {
     Element* result = ELEMENT({
         .type = ELEMENT_INPUT,
-        .index = r_elements.count,
+        .index = next_element_index(),
         .text = NULL,
         .children = NULL,
         .attributes = NULL,
         .input = {
-            .placeholder = arena_strdup(&r_arena, placeholder),
+            .placeholder = is_static ? (char*)placeholder : arena_strdup(&r_arena, placeholder),
             .on_change = on_change
         }
     });
 
-    arena_da_append(&r_arena, &r_elements, result);
+    arena_da_append(&r_tables_arena, &r_elements, result);
 
     return result;
 }
 
+Element* input(const char* placeholder, bool (*on_change)(const char*))
+{
+    return _input(placeholder, false, on_change);
+}
+
+Element* input_static(const char* placeholder, bool (*on_change)(const char*))
+{
+    return _input(placeholder, true, on_change);
+}
+
 Element* canvas(char* id, size_t width, size_t height)
 {
     Element* result = ELEMENT({
         .type = ELEMENT_CANVAS,
-        .index = r_elements.count,
+        .index = next_element_index(),
         .text = NULL,
         .children = NULL,
         .attributes = NULL,
         .canvas = {
             .width = width,
             .height = height,
-            .id = id ? arena_strdup(&r_arena, id) : arena_sprintf(&r_arena, "canvas-%zu", r_elements.count)
+            .id = id ? arena_strdup(&r_arena, id) : arena_sprintf(&r_arena, "canvas-%zu", next_element_index())
         }
     });
 
-    arena_da_append(&r_arena, &r_elements, result);
+    arena_da_append(&r_tables_arena, &r_elements, result);
 
     return result;
 }
 
-
 Element* text_element(const char* tag, const char* text)
 {
     Element* result = element(tag, NULL);
@@ -322,93 +782,1455 @@ Element* text_element(const char* tag, const char* text)
     return result;
 }
 
-Element* render_component();
+// Unchanged static text is also cheap to diff, the comparison stops at the pointer, text must never
+// change (see attributes_static())
+Element* text_static(const char* tag, const char* text)
+{
+    Element* result = element_static(tag, NULL);
+    result->text = (char*)text;
+    return result;
+}
 
-[[clang::export_name("init_component")]]
-void init_component();
+// Virtualized lists
+//
+// virtual_list() only renders the rows inside the scrolled viewport of its host node plus
+// VIRTUAL_LIST_OVERSCAN rows on both sides, so its render cost does not depend on count. Every row
+// is wrapped into a node of exactly row_height pixels and keyed by its index, scrolling just removes
+// and adds the rows at the edges. The host reports the scroll offset and viewport height through
+// invoke_on_scroll and the list is rendered again once the window of rows changes.
+//
+// Scroll states are assigned in call order, so the number and order of virtual_list() calls must
+// stay the same between renders and they cannot be inside memo().
+#define VIRTUAL_LIST_CAPACITY 16
+#define VIRTUAL_LIST_OVERSCAN 8
+// Rows rendered before the host has reported the viewport height
+#define VIRTUAL_LIST_INITIAL_ROWS 32
 
-[[clang::export_name("render_component")]]
-Element* render_component_internal() {
+typedef struct {
+    size_t scroll_top;
+    // 0 until the host has reported it
+    size_t viewport_height;
+} VirtualListState;
+
+VirtualListState r_virtual_lists[VIRTUAL_LIST_CAPACITY] = {0};
+// Number of virtual_list() calls in the current render
+size_t r_virtual_list_count = 0;
+
+void virtual_list_window(VirtualListState* state, size_t count, size_t row_height, size_t* first, size_t* last)
+{
+    size_t visible = state->viewport_height > 0
+        ? (state->viewport_height + row_height - 1) / row_height + 1
+        : VIRTUAL_LIST_INITIAL_ROWS;
+    size_t top = state->scroll_top / row_height;
+
+    *first = top > VIRTUAL_LIST_OVERSCAN ? top - VIRTUAL_LIST_OVERSCAN : 0;
+    *last = top + visible + VIRTUAL_LIST_OVERSCAN;
+    if (*last > count) *last = count;
+    if (*first > *last) *first = *last;
+}
+
+Element* virtual_list(size_t count, size_t row_height, Element* (*render_row)(size_t index))
+{
+    ASSERT(row_height > 0);
+    ASSERT(r_virtual_list_count < VIRTUAL_LIST_CAPACITY);
+
+    size_t state = r_virtual_list_count++;
+    size_t first, last;
+    virtual_list_window(&r_virtual_lists[state], count, row_height, &first, &last);
+
+    Children* rows = children_empty();
+    children_reserve(rows, last - first);
+    const char* row_style = arena_sprintf(&r_arena, "height: %zupx; overflow: hidden", row_height);
+    for (size_t i = first; i < last; i++) {
+        Element* row = attributes(element("div", children(render_row(i))), "style", row_style);
+        row->key = arena_sprintf(&r_arena, "%zu", i);
+        rows->items[rows->count++] = row;
+    }
+
+    Element* result = ELEMENT({
+        .type = ELEMENT_VIRTUAL_LIST,
+        .index = next_element_index(),
+        .text = NULL,
+        .children = rows,
+        .attributes = NULL,
+        .virtual_list = {
+            .count = count,
+            .row_height = row_height,
+            .first = first,
+            .last = last,
+            .state = state
+        }
+    });
+
+    arena_da_append(&r_tables_arena, &r_elements, result);
+
+    return result;
+}
+
+// Memoized subtrees
+//
+// memo() keeps the subtree built by render in a retained arena and returns the very same subtree as
+// long as the dependency bytes do not change. The diff recognizes it by pointer and skips it, so
+// an unchanged memoized subtree produces no commands at all and the host never touches it.
+//
+// Like frames, every slot alternates between two arenas and element tables, so the subtree the
+// previous frame refers to stays valid while a new one is rendered.
+//
+// memo() can be nested, a key must always be used from the same place though.
+#define MEMO_CAPACITY 64
+
+typedef struct {
+    const char* key;
+    Arena arenas[2];
+    Elements elements[2];
+    size_t current;
+    void* deps;
+    size_t deps_size;
+    Element* root;
+    // Frame the slot was last used in, and the one it was used in before that
+    size_t frame;
+    size_t prev_frame;
+    // Frame in which root was reused from the previous frame
+    size_t shared_frame;
+    // Frame in which the subtree was last rendered, the table of the frame before is the other one
+    size_t rendered_frame;
+    // Slot whose subtree contains this one, 0 for the frame itself. Set again whenever the slot is
+    // used, a subtree that is rendered again without it lets go of it.
+    size_t owner;
+} MemoSlot;
+
+MemoSlot r_memo_slots[MEMO_CAPACITY] = {0};
+size_t r_memo_count = 0;
+// Slot currently being rendered, 0 for the frame itself
+size_t r_memo_owner = 0;
+// Memo keys live as long as their slots
+Arena r_memo_arena = {0};
+
+bool memo_deps_equal(MemoSlot* slot, const void* deps, size_t deps_size)
+{
+    if (slot->deps_size != deps_size) {
+        return false;
+    }
+
+    const uint8_t* a = slot->deps;
+    const uint8_t* b = deps;
+    for (size_t i = 0; i < deps_size; i++) {
+        if (a[i] != b[i]) return false;
+    }
+
+    return true;
+}
+
+MemoSlot* find_memo_slot(const char* key)
+{
+    for (size_t i = 0; i < r_memo_count; i++) {
+        if (str_eq(r_memo_slots[i].key, key)) {
+            return &r_memo_slots[i];
+        }
+    }
+
+    ASSERT(r_memo_count < MEMO_CAPACITY);
+    MemoSlot* slot = &r_memo_slots[r_memo_count++];
+    slot->key = arena_strdup(&r_memo_arena, key);
+    return slot;
+}
+
+// Marks a slot as used by the current frame, along with the slots nested in its subtree
+void memo_use(MemoSlot* slot, bool shared)
+{
+    // A subtree can only appear once in a tree, its elements carry the ids of a single host node each
+    ASSERT(slot->frame != r_frame);
+    slot->prev_frame = slot->frame;
+    slot->frame = r_frame;
+    if (shared) {
+        slot->shared_frame = r_frame;
+    }
+
+    size_t id = slot - r_memo_slots + 1;
+    for (size_t i = 0; i < r_memo_count; i++) {
+        if (r_memo_slots[i].owner == id) {
+            memo_use(&r_memo_slots[i], shared);
+        }
+    }
+}
+
+Element* memo(const char* key, const void* deps, size_t deps_size, Element* (*render)(const void* deps))
+{
+    MemoSlot* slot = find_memo_slot(key);
+    slot->owner = r_memo_owner;
+
+    if (slot->root && memo_deps_equal(slot, deps, deps_size)) {
+        memo_use(slot, slot->frame + 1 == r_frame);
+        return slot->root;
+    }
+
+    ASSERT(slot->frame != r_frame);
+    slot->prev_frame = slot->frame;
+    slot->frame = r_frame;
+    slot->rendered_frame = r_frame;
+
+    // Build the new subtree in the other arena and element table of the slot
+    Arena frame_arena = r_arena;
+    Elements frame_elements = r_elements;
+    size_t frame_index_base = r_index_base;
+    size_t frame_owner = r_memo_owner;
+
+    slot->current ^= 1;
+    r_arena = slot->arenas[slot->current];
     arena_reset(&r_arena);
+    r_elements = slot->elements[slot->current];
     r_elements.count = 0;
-    r_elements.capacity = 0;
+    r_index_base = (size_t)(slot - r_memo_slots + 1) << MEMO_INDEX_SHIFT;
+    r_memo_owner = slot - r_memo_slots + 1;
+
+    // Only the slots used by the new subtree are nested in it, memo_use must not revive the others
+    for (size_t i = 0; i < r_memo_count; i++) {
+        if (r_memo_slots[i].owner == r_memo_owner) {
+            r_memo_slots[i].owner = 0;
+        }
+    }
+
+    slot->deps = deps_size > 0 ? arena_memdup(&r_arena, (void*)deps, deps_size) : NULL;
+    slot->deps_size = deps_size;
+    slot->root = render(slot->deps);
+    ASSERT(slot->root != NULL);
+    slot->root->memo = slot - r_memo_slots + 1;
+
+    slot->arenas[slot->current] = r_arena;
+    slot->elements[slot->current] = r_elements;
+    r_arena = frame_arena;
+    r_elements = frame_elements;
+    r_index_base = frame_index_base;
+    r_memo_owner = frame_owner;
 
-    return render_component();
+    return slot->root;
 }
 
-[[clang::export_name("invoke_on_click")]]
-void invoke_on_click(size_t element_index) {
-    ASSERT(r_elements.count > 0 && element_index < r_elements.count);
-    Element* element = r_elements.items[element_index];
+// Finds an element of the current frame, including memoized subtrees, by its index
+Element* find_element(size_t index)
+{
+    size_t table = index >> MEMO_INDEX_SHIFT;
+    size_t position = index & (((size_t)1 << MEMO_INDEX_SHIFT) - 1);
+
+    Elements* elements = &r_elements;
+    if (table > 0) {
+        ASSERT(table <= r_memo_count);
+        MemoSlot* slot = &r_memo_slots[table - 1];
+        elements = &slot->elements[slot->current];
+    }
 
-    if (element->type == ELEMENT_BUTTON && element->button.on_click) {
-        element->button.on_click(element->button.on_click_args);
-        platform_rerender();
+    if (position >= elements->count) {
+        return NULL;
     }
+    return elements->items[position];
 }
 
-[[clang::export_name("invoke_on_change")]]
-void invoke_on_change(size_t element_index, const char* value) {
-    ASSERT(r_elements.count > 0 && element_index < r_elements.count);
-    Element* element = r_elements.items[element_index];
+// Element of the previous frame by its index, including memoized subtrees, NULL if that frame did
+// not have it
+Element* prev_element(size_t index)
+{
+    size_t table = index >> MEMO_INDEX_SHIFT;
+    size_t position = index & (((size_t)1 << MEMO_INDEX_SHIFT) - 1);
 
-    if (element->type == ELEMENT_INPUT && element->input.on_change) {
-        element->input.on_change(value);
-        platform_rerender();
+    Elements* elements = &r_prev_elements;
+    if (table > 0) {
+        if (table > r_memo_count) {
+            return NULL;
+        }
+        // The table of a slot the previous frame did not use belongs to an older frame
+        MemoSlot* slot = &r_memo_slots[table - 1];
+        size_t used_frame = slot->frame == r_frame ? slot->prev_frame : slot->frame;
+        if (used_frame == 0 || used_frame + 1 != r_frame) {
+            return NULL;
+        }
+        // Rendered again in this frame, the previous frame still used the table it was built in
+        size_t current = slot->rendered_frame == r_frame ? slot->current ^ 1 : slot->current;
+        elements = &slot->elements[current];
+    }
+
+    if (position >= elements->count) {
+        return NULL;
     }
+    return elements->items[position];
 }
 
-[[clang::export_name("invoke_animation_frame_callback")]]
-void invoke_animation_frame_callback(void (*callback)(float dt), float dt) {
-    ASSERT(callback != NULL);
-    callback(dt);
+// A memoized subtree that was reused from the previous frame keeps its host nodes. It is never
+// patched or recreated, at most its root node is moved to wherever the subtree is used now.
+bool element_shared_with_prev_frame(Element* element)
+{
+    return element->memo > 0 && r_memo_slots[element->memo - 1].shared_frame == r_frame;
 }
 
-Arena input_arena = {0};
-#define INPUT_BUFFER_CAPACITY 4096
-[[clang::export_name("get_input_buffer")]]
-void* get_input_buffer() {
-    return arena_alloc(&input_arena, INPUT_BUFFER_CAPACITY);
+// Node store
+//
+// Every render flattens its tree into parallel arrays before it is diffed. A node is a 32-bit id, its
+// position in depth-first order, and each of its fields is at that position in the array of the field.
+// The diff walks children through first_child and next_sibling and only touches the arrays it
+// compares, all attributes of a render lie in one contiguous block, and the host can read the whole
+// store through typed-array views of linear memory. Both blocks are sized by counting the tree
+// first, nothing grows per node.
+//
+// The store of the previous frame is kept for the diff, the two alternate like the frame arenas.
+#define NODE_NONE UINT32_MAX
+
+// Every array holds count entries, its layout is read by the host
+typedef struct {
+    uint32_t count;
+    uint32_t attribute_count;
+    uint8_t* type;
+    // Tag of generic elements and its interned id, NULL and 0 for the other types
+    const char** tag;
+    uint32_t* tag_id;
+    const char** text;
+    const char** key;
+    uint32_t* first_child;
+    uint32_t* next_sibling;
+    // Attributes of a node are attributes[attributes_start, attributes_start + attributes_count)
+    uint32_t* attributes_start;
+    uint32_t* attributes_count;
+    Attribute* attributes;
+    // Host node ids, assigned by the diff
+    uint32_t* node;
+    // Memo slot + 1 for roots of memoized subtrees, 0 otherwise
+    uint32_t* memo;
+    // Elements the nodes were built from, for their type-specific fields and listeners
+    Element** element;
+} NodeStore;
+
+NodeStore r_node_stores[2] = {0};
+Arena r_node_arenas[2] = {0};
+NodeStore* r_nodes = &r_node_stores[0];
+NodeStore* r_prev_nodes = &r_node_stores[1];
+
+void node_store_count(Element* element, uint32_t* nodes, uint32_t* attributes)
+{
+    (*nodes)++;
+    if (element->attributes) {
+        *attributes += element->attributes->count;
+    }
+
+    if (element->children) {
+        for (size_t i = 0; i < element->children->count; i++) {
+            node_store_count(element->children->items[i], nodes, attributes);
+        }
+    }
 }
 
-// Export Element struct layout as a packed array of offsets
-[[clang::export_name("get_element_layout")]]
-const size_t* get_element_layout() {
-    static const size_t layout[] = {
-        offsetof(Element, type),        // 0: element type (enum)
-        offsetof(Element, index),       // 1: element index
-        offsetof(Element, text),        // 2: common text field
-        offsetof(Element, children),    // 3: common children field
-        offsetof(Element, attributes),  // 4: common attributes field
-        
-        // Union offset
-        offsetof(Element, generic),     // 5: union offset
-        
-        // Generic element offsets (relative to union start)
-        offsetof(GenericElement, tag),  // 6
-        
-        // Button element offsets (relative to union start)
-        offsetof(ButtonElement, on_click),     // 7
-        offsetof(ButtonElement, on_click_args), // 8
-        
-        // Input element offsets (relative to union start)
-        offsetof(InputElement, placeholder),   // 9
-        offsetof(InputElement, on_change),     // 10
+uint32_t node_store_add(NodeStore* store, Element* element)
+{
+    uint32_t id = store->count++;
+    bool generic = element->type == ELEMENT_GENERIC;
+    store->type[id] = element->type;
+    store->tag[id] = generic ? element->generic.tag : NULL;
+    store->tag_id[id] = generic ? element->generic.tag_id : 0;
+    store->text[id] = element->text;
+    store->key[id] = element->key;
+    // Memoized subtrees reused from the previous frame keep the nodes they were given then
+    store->node[id] = element->node;
+    store->memo[id] = element->memo;
+    store->element[id] = element;
+    element->id = id;
+
+    uint32_t attribute_count = element->attributes ? element->attributes->count : 0;
+    store->attributes_start[id] = store->attribute_count;
+    store->attributes_count[id] = attribute_count;
+    for (uint32_t i = 0; i < attribute_count; i++) {
+        store->attributes[store->attribute_count++] = element->attributes->items[i];
+    }
 
-        // Canvas element offsets (relative to union start)
-        offsetof(CanvasElement, id),           // 11
-        offsetof(CanvasElement, width),        // 12
-        offsetof(CanvasElement, height),       // 13
+    store->first_child[id] = NODE_NONE;
+    store->next_sibling[id] = NODE_NONE;
+    if (element->children) {
+        uint32_t previous = NODE_NONE;
+        for (size_t i = 0; i < element->children->count; i++) {
+            uint32_t child = node_store_add(store, element->children->items[i]);
+            if (previous == NODE_NONE) {
+                store->first_child[id] = child;
+            } else {
+                store->next_sibling[previous] = child;
+            }
+            previous = child;
+        }
+    }
 
-        // Total size of the Element struct
-        sizeof(Element)
-    };
-    return layout;
+    return id;
+}
+
+// Replaces the store of the frame before the previous one with the tree of root
+void node_store_build(Element* root)
+{
+    NodeStore* store = r_prev_nodes;
+    r_prev_nodes = r_nodes;
+    r_nodes = store;
+
+    Arena* arena = &r_node_arenas[store - r_node_stores];
+    arena_reset(arena);
+
+    uint32_t nodes = 0;
+    uint32_t attributes = 0;
+    node_store_count(root, &nodes, &attributes);
+
+    store->count = 0;
+    store->attribute_count = 0;
+    store->type = arena_alloc(arena, nodes * sizeof(*store->type));
+    store->tag = arena_alloc(arena, nodes * sizeof(*store->tag));
+    store->tag_id = arena_alloc(arena, nodes * sizeof(*store->tag_id));
+    store->text = arena_alloc(arena, nodes * sizeof(*store->text));
+    store->key = arena_alloc(arena, nodes * sizeof(*store->key));
+    store->first_child = arena_alloc(arena, nodes * sizeof(*store->first_child));
+    store->next_sibling = arena_alloc(arena, nodes * sizeof(*store->next_sibling));
+    store->attributes_start = arena_alloc(arena, nodes * sizeof(*store->attributes_start));
+    store->attributes_count = arena_alloc(arena, nodes * sizeof(*store->attributes_count));
+    store->attributes = arena_alloc(arena, attributes * sizeof(*store->attributes));
+    store->node = arena_alloc(arena, nodes * sizeof(*store->node));
+    store->memo = arena_alloc(arena, nodes * sizeof(*store->memo));
+    store->element = arena_alloc(arena, nodes * sizeof(*store->element));
+
+    node_store_add(store, root);
+}
+
+// The node ids also stay with the elements, memoized subtrees are flattened again from them
+void node_store_set_node(NodeStore* store, uint32_t id, size_t node)
+{
+    store->node[id] = node;
+    store->element[id]->node = node;
+}
+
+bool node_shared_with_prev_frame(NodeStore* store, uint32_t id)
+{
+    uint32_t memo = store->memo[id];
+    return memo > 0 && r_memo_slots[memo - 1].shared_frame == r_frame;
+}
+
+[[clang::export_name("get_node_store")]]
+const NodeStore* get_node_store()
+{
+    return r_nodes;
+}
+
+// Render command stream
+//
+// Every render is diffed against the previous frame inside wasm and only the differences are
+// written into a single contiguous byte buffer of patch commands that the host applies to its
+// live nodes.
+//
+// Every command starts with a one byte opcode followed by little-endian u32 fields.
+// Strings are indices into the string pool of the render: all strings a render sends are copied
+// into one contiguous buffer, each terminated by a NUL, so the host can decode all of them at once.
+// Refs are interned strings: a u32 id, with the string following only the first time an id is sent
+// and STRING_REF_DEFINE set in the id. Id 0 is a string that is not interned and always follows.
+// Host nodes are referred to by the ids the diff keeps in NodeStore.node, node 0 is the component root.
+//
+//   OPEN              node:u32 type:u8 index:u32 events:u32 <type-specific fields>
+//                       generic: tag:ref
+//                       input:   placeholder:str
+//                       canvas:  id:str width:u32 height:u32
+//                       virtual list: count:u32 row_height:u32 first:u32 last:u32
+//   ATTRIBUTE         name:ref value:ref
+//   TEXT              text:str
+//   CLOSE
+//   MOVE              parent:u32 node:u32 before:u32
+//   REMOVE            node:u32
+//   SET_TEXT          node:u32 text:str
+//   SET_ATTRIBUTE     node:u32 name:ref value:ref
+//   REMOVE_ATTRIBUTE  node:u32 name:ref
+//   SET_INDEX         node:u32 index:u32 events:u32
+//   SET_WINDOW        node:u32 count:u32 row_height:u32 first:u32 last:u32
+//
+// events is the mask of EventTypes the element handles, the host dispatches those to it by index.
+//
+// OPEN ... CLOSE creates a new detached subtree: attributes and text directly follow their OPEN,
+// children come after them. MOVE inserts an existing node into parent before the node `before`,
+// or appends it when `before` is 0, it can also appear inside OPEN ... CLOSE to place a retained
+// subtree. REMOVE detaches a node together with its whole subtree, nodes of that subtree may still
+// be moved elsewhere by later commands of the same render.
+typedef enum {
+    RENDER_OP_OPEN = 1,
+    RENDER_OP_ATTRIBUTE = 2,
+    RENDER_OP_TEXT = 3,
+    RENDER_OP_CLOSE = 4,
+    RENDER_OP_MOVE = 5,
+    RENDER_OP_REMOVE = 6,
+    RENDER_OP_SET_TEXT = 7,
+    RENDER_OP_SET_ATTRIBUTE = 8,
+    RENDER_OP_REMOVE_ATTRIBUTE = 9,
+    RENDER_OP_SET_INDEX = 10,
+    RENDER_OP_SET_WINDOW = 11,
+} RenderOp;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    uint8_t* items;
+} RenderCommands;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    char* items;
+} StringPool;
+
+// Everything a render sends to the host, its layout is read by the host
+typedef struct {
+    RenderCommands commands;
+    StringPool strings;
+    // Number of strings in the pool
+    size_t string_count;
+} RenderOutput;
+
+// The render output outlives render arena resets, it only grows when a frame does not fit anymore
+Arena r_commands_arena = {0};
+RenderOutput r_output = {0};
+
+// Scratch memory of a single diff, reset before every render
+Arena r_diff_arena = {0};
+
+#define ROOT_NODE 0
+#define STRING_REF_DEFINE 0x80000000u
+size_t r_next_node = ROOT_NODE + 1;
+
+void emit_u8(uint8_t value)
+{
+    arena_da_append(&r_commands_arena, &r_output.commands, value);
+}
+
+void emit_u32(uint32_t value)
+{
+    uint8_t bytes[4] = {
+        value & 0xFF,
+        (value >> 8) & 0xFF,
+        (value >> 16) & 0xFF,
+        (value >> 24) & 0xFF
+    };
+    arena_da_append_many(&r_commands_arena, &r_output.commands, bytes, 4);
+}
+
+// Copies the string together with its terminator into the pool and emits its index
+void emit_pooled_string(const char* value, size_t length)
+{
+    arena_da_append_many(&r_commands_arena, &r_output.strings, value, length + 1);
+    emit_u32(r_output.string_count++);
+}
+
+// NULL is sent as an empty string
+void emit_string(const char* value)
+{
+    if (value == NULL) {
+        value = "";
+    }
+    emit_pooled_string(value, arena_strlen(value));
+}
+
+void emit_string_ref(const char* value, uint32_t id)
+{
+    if (id == 0) {
+        emit_u32(0);
+        emit_string(value);
+        return;
+    }
+
+    InternedString* interned = &r_interned[id];
+    if (interned->sent) {
+        emit_u32(id);
+        return;
+    }
+
+    interned->sent = true;
+    emit_u32(id | STRING_REF_DEFINE);
+    emit_pooled_string(interned->value, interned->length);
+}
+
+void emit_move(size_t parent, size_t node, size_t before)
+{
+    emit_u8(RENDER_OP_MOVE);
+    emit_u32(parent);
+    emit_u32(node);
+    emit_u32(before);
+}
+
+void emit_remove(size_t node)
+{
+    emit_u8(RENDER_OP_REMOVE);
+    emit_u32(node);
+}
+
+void emit_set_text(size_t node, const char* text)
+{
+    emit_u8(RENDER_OP_SET_TEXT);
+    emit_u32(node);
+    emit_string(text);
+}
+
+void emit_set_attribute(size_t node, Attribute* attribute)
+{
+    emit_u8(RENDER_OP_SET_ATTRIBUTE);
+    emit_u32(node);
+    emit_string_ref(attribute->name, attribute->name_id);
+    emit_string_ref(attribute->value, attribute->value_id);
+}
+
+void emit_remove_attribute(size_t node, Attribute* attribute)
+{
+    emit_u8(RENDER_OP_REMOVE_ATTRIBUTE);
+    emit_u32(node);
+    emit_string_ref(attribute->name, attribute->name_id);
+}
+
+// For the attributes backed by fields of type-specific elements
+void emit_set_property(size_t node, const char* name, const char* value)
+{
+    Attribute attribute = { .name = name, .value = value, .name_id = intern(name), .value_id = 0 };
+    emit_set_attribute(node, &attribute);
+}
+
+void emit_set_index(size_t node, size_t index, uint32_t events)
+{
+    emit_u8(RENDER_OP_SET_INDEX);
+    emit_u32(node);
+    emit_u32(index);
+    emit_u32(events);
+}
+
+// Mask of the EventTypes the element handles
+uint32_t element_events(Element* element)
+{
+    uint32_t events = 0;
+    if (element->type == ELEMENT_BUTTON) events |= 1 << EVENT_CLICK;
+    if (element->type == ELEMENT_INPUT) events |= 1 << EVENT_CHANGE;
+    // Inputs with a value report every edit, the diff has to know what they show
+    if (element->type == ELEMENT_INPUT && element->text) events |= 1 << EVENT_INPUT;
+
+    if (element->listeners) {
+        for (size_t i = 0; i < element->listeners->count; i++) {
+            events |= 1 << element->listeners->items[i].type;
+        }
+    }
+
+    return events;
+}
+
+// Only elements the host calls into need to know their index on the host side
+bool element_is_interactive(Element* element)
+{
+    return element->type == ELEMENT_VIRTUAL_LIST || element_events(element) != 0;
+}
+
+void emit_window(VirtualListElement* virtual_list)
+{
+    emit_u32(virtual_list->count);
+    emit_u32(virtual_list->row_height);
+    emit_u32(virtual_list->first);
+    emit_u32(virtual_list->last);
+}
+
+// Emits a new detached subtree for node id of the current store and assigns host nodes to all of it
+void create_node(uint32_t id)
+{
+    NodeStore* store = r_nodes;
+    Element* element = store->element[id];
+    size_t node = r_next_node++;
+    node_store_set_node(store, id, node);
+
+    emit_u8(RENDER_OP_OPEN);
+    emit_u32(node);
+    emit_u8(store->type[id]);
+    emit_u32(element->index);
+    emit_u32(element_events(element));
+
+    switch (store->type[id]) {
+    case ELEMENT_GENERIC:
+        emit_string_ref(store->tag[id], store->tag_id[id]);
+        break;
+    case ELEMENT_BUTTON:
+        break;
+    case ELEMENT_INPUT:
+        emit_string(element->input.placeholder);
+        break;
+    case ELEMENT_CANVAS:
+        emit_string(element->canvas.id);
+        emit_u32(element->canvas.width);
+        emit_u32(element->canvas.height);
+        break;
+    case ELEMENT_VIRTUAL_LIST:
+        emit_window(&element->virtual_list);
+        break;
+    default:
+        ASSERT(0 && "Unknown element type");
+    }
+
+    Attribute* attributes = &store->attributes[store->attributes_start[id]];
+    for (uint32_t i = 0; i < store->attributes_count[id]; i++) {
+        emit_u8(RENDER_OP_ATTRIBUTE);
+        emit_string_ref(attributes[i].name, attributes[i].name_id);
+        emit_string_ref(attributes[i].value, attributes[i].value_id);
+    }
+
+    if (store->text[id]) {
+        emit_u8(RENDER_OP_TEXT);
+        emit_string(store->text[id]);
+    }
+
+    for (uint32_t child = store->first_child[id]; child != NODE_NONE; child = store->next_sibling[child]) {
+        if (node_shared_with_prev_frame(store, child)) {
+            emit_move(node, store->node[child], 0);
+        } else {
+            create_node(child);
+        }
+    }
+
+    emit_u8(RENDER_OP_CLOSE);
+}
+
+// Nodes can only be patched in place if they would create the same kind of host node. old_id is a
+// node of the previous store, new_id one of the current store.
+bool nodes_compatible(uint32_t old_id, uint32_t new_id)
+{
+    NodeStore* old_store = r_prev_nodes;
+    NodeStore* new_store = r_nodes;
+    if (old_store->type[old_id] != new_store->type[new_id] || !str_eq(old_store->key[old_id], new_store->key[new_id])) {
+        return false;
+    }
+
+    if (new_store->type[new_id] == ELEMENT_GENERIC) {
+        return interned_eq(old_store->tag[old_id], old_store->tag_id[old_id], new_store->tag[new_id], new_store->tag_id[new_id]);
+    }
+
+    return true;
+}
+
+// Finds the attribute with the same name as attribute among count attributes
+Attribute* find_attribute(Attribute* attributes, uint32_t count, Attribute* attribute)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        Attribute* candidate = &attributes[i];
+        if (interned_eq(candidate->name, candidate->name_id, attribute->name, attribute->name_id)) {
+            return candidate;
+        }
+    }
+
+    return NULL;
+}
+
+void diff_attributes(size_t node, uint32_t old_id, uint32_t new_id)
+{
+    Attribute* old_attributes = &r_prev_nodes->attributes[r_prev_nodes->attributes_start[old_id]];
+    uint32_t old_count = r_prev_nodes->attributes_count[old_id];
+    Attribute* new_attributes = &r_nodes->attributes[r_nodes->attributes_start[new_id]];
+    uint32_t new_count = r_nodes->attributes_count[new_id];
+
+    for (uint32_t i = 0; i < new_count; i++) {
+        Attribute* attribute = &new_attributes[i];
+        Attribute* old_attribute = find_attribute(old_attributes, old_count, attribute);
+        if (old_attribute == NULL || !interned_eq(old_attribute->value, old_attribute->value_id, attribute->value, attribute->value_id)) {
+            emit_set_attribute(node, attribute);
+        }
+    }
+
+    for (uint32_t i = 0; i < old_count; i++) {
+        Attribute* attribute = &old_attributes[i];
+        if (find_attribute(new_attributes, new_count, attribute) == NULL) {
+            emit_remove_attribute(node, attribute);
+        }
+    }
+}
+
+// Open addressing table from key to position in the old children
+typedef struct {
+    size_t capacity;
+    ptrdiff_t* slots;
+} KeyIndex;
+
+// keys are the keys of the old children in order, NULL for the unkeyed ones
+KeyIndex key_index_build(const char** keys, size_t count)
+{
+    KeyIndex index = { .capacity = 0, .slots = NULL };
+
+    size_t keyed_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (keys[i]) keyed_count++;
+    }
+
+    if (keyed_count == 0) {
+        return index;
+    }
+
+    index.capacity = 16;
+    while (index.capacity < keyed_count * 2) {
+        index.capacity *= 2;
+    }
+
+    index.slots = arena_alloc(&r_diff_arena, index.capacity * sizeof(*index.slots));
+    for (size_t i = 0; i < index.capacity; i++) {
+        index.slots[i] = -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (keys[i] == NULL) continue;
+
+        size_t slot = str_hash(keys[i]) & (index.capacity - 1);
+        while (index.slots[slot] >= 0) {
+            // Duplicate keys keep the first occurrence, the rest are recreated
+            if (str_eq(keys[index.slots[slot]], keys[i])) break;
+            slot = (slot + 1) & (index.capacity - 1);
+        }
+
+        if (index.slots[slot] < 0) {
+            index.slots[slot] = i;
+        }
+    }
+
+    return index;
+}
+
+ptrdiff_t key_index_find(KeyIndex* index, const char** keys, const char* key)
+{
+    if (index->capacity == 0) {
+        return -1;
+    }
+
+    size_t slot = str_hash(key) & (index->capacity - 1);
+    while (index->slots[slot] >= 0) {
+        if (str_eq(keys[index->slots[slot]], key)) {
+            return index->slots[slot];
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+
+    return -1;
+}
+
+// Marks the new children whose old positions form the longest increasing subsequence.
+// Those keep their relative order, so only the remaining children have to be moved.
+bool* stable_children(ptrdiff_t* sources, size_t count)
+{
+    bool* stable = arena_alloc(&r_diff_arena, count * sizeof(*stable));
+    size_t* tails = arena_alloc(&r_diff_arena, count * sizeof(*tails));
+    size_t* previous = arena_alloc(&r_diff_arena, count * sizeof(*previous));
+    size_t length = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        stable[i] = false;
+        if (sources[i] < 0) continue;
+
+        size_t low = 0;
+        size_t high = length;
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (sources[tails[middle]] < sources[i]) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        previous[i] = low > 0 ? tails[low - 1] : SIZE_MAX;
+        tails[low] = i;
+        if (low == length) length++;
+    }
+
+    if (length > 0) {
+        for (size_t i = tails[length - 1]; i != SIZE_MAX; i = previous[i]) {
+            stable[i] = true;
+        }
+    }
+
+    return stable;
+}
+
+void diff_node(uint32_t old_id, uint32_t new_id);
+
+// Ids of the children of node id in store, in order, in scratch memory of the diff
+uint32_t* node_children(NodeStore* store, uint32_t id, size_t* count)
+{
+    *count = 0;
+    for (uint32_t child = store->first_child[id]; child != NODE_NONE; child = store->next_sibling[child]) {
+        (*count)++;
+    }
+
+    uint32_t* children = arena_alloc(&r_diff_arena, *count * sizeof(*children));
+    size_t i = 0;
+    for (uint32_t child = store->first_child[id]; child != NODE_NONE; child = store->next_sibling[child]) {
+        children[i++] = child;
+    }
+    return children;
+}
+
+void diff_children(size_t parent, uint32_t old_id, uint32_t new_id)
+{
+    NodeStore* old_store = r_prev_nodes;
+    NodeStore* new_store = r_nodes;
+    if (old_store->first_child[old_id] == NODE_NONE && new_store->first_child[new_id] == NODE_NONE) {
+        return;
+    }
+
+    size_t old_count = 0;
+    size_t new_count = 0;
+    uint32_t* old_items = node_children(old_store, old_id, &old_count);
+    uint32_t* new_items = node_children(new_store, new_id, &new_count);
+
+    // sources[i] is the position of the old child reused for new child i, or -1 if it has to be created
+    ptrdiff_t* sources = arena_alloc(&r_diff_arena, new_count * sizeof(*sources));
+    bool* matched = arena_alloc(&r_diff_arena, old_count * sizeof(*matched));
+    const char** old_keys = arena_alloc(&r_diff_arena, old_count * sizeof(*old_keys));
+    for (size_t i = 0; i < old_count; i++) {
+        matched[i] = false;
+        old_keys[i] = old_store->key[old_items[i]];
+    }
+
+    // Keyed children are matched by key, the rest by their position among the unkeyed ones.
+    // Reused memoized subtrees only ever match themselves.
+    KeyIndex key_index = key_index_build(old_keys, old_count);
+    size_t cursor = 0;
+    for (size_t i = 0; i < new_count; i++) {
+        uint32_t child = new_items[i];
+        Element* element = new_store->element[child];
+        ptrdiff_t source = -1;
+
+        if (node_shared_with_prev_frame(new_store, child)) {
+            for (size_t j = 0; j < old_count; j++) {
+                if (old_store->element[old_items[j]] == element) {
+                    source = j;
+                    break;
+                }
+            }
+        } else if (new_store->key[child]) {
+            source = key_index_find(&key_index, old_keys, new_store->key[child]);
+        } else {
+            while (cursor < old_count && old_keys[cursor]) {
+                cursor++;
+            }
+            if (cursor < old_count) {
+                source = cursor++;
+            }
+        }
+
+        if (source >= 0 && old_store->element[old_items[source]] != element) {
+            uint32_t candidate = old_items[source];
+            if (matched[source] || node_shared_with_prev_frame(old_store, candidate) || !nodes_compatible(candidate, child)) {
+                source = -1;
+            }
+        }
+
+        if (source >= 0) {
+            matched[source] = true;
+        }
+        sources[i] = source;
+    }
+
+    // Reused memoized subtrees are still part of the new tree, they get moved instead
+    for (size_t i = 0; i < old_count; i++) {
+        if (!matched[i] && !node_shared_with_prev_frame(old_store, old_items[i])) {
+            emit_remove(old_store->node[old_items[i]]);
+        }
+    }
+
+    // Walk backwards so the next sibling is always in its final place already
+    bool* stable = stable_children(sources, new_count);
+    for (size_t i = new_count; i-- > 0;) {
+        uint32_t child = new_items[i];
+        size_t before = i + 1 < new_count ? new_store->node[new_items[i + 1]] : 0;
+
+        if (node_shared_with_prev_frame(new_store, child)) {
+            if (sources[i] < 0 || !stable[i]) {
+                emit_move(parent, new_store->node[child], before);
+            }
+            continue;
+        }
+
+        if (sources[i] < 0) {
+            create_node(child);
+            emit_move(parent, new_store->node[child], before);
+            continue;
+        }
+
+        diff_node(old_items[sources[i]], child);
+        if (!stable[i]) {
+            emit_move(parent, new_store->node[child], before);
+        }
+    }
+}
+
+// Patches the host node of old_id in the previous store to match new_id in the current one, they
+// must be compatible
+void diff_node(uint32_t old_id, uint32_t new_id)
+{
+    NodeStore* old_store = r_prev_nodes;
+    NodeStore* new_store = r_nodes;
+    Element* old_element = old_store->element[old_id];
+    Element* new_element = new_store->element[new_id];
+    if (old_element == new_element) {
+        return;
+    }
+
+    size_t node = old_store->node[old_id];
+    node_store_set_node(new_store, new_id, node);
+
+    if (element_is_interactive(new_element) || element_is_interactive(old_element)) {
+        uint32_t events = element_events(new_element);
+        if (old_element->index != new_element->index || element_events(old_element) != events) {
+            emit_set_index(node, new_element->index, events);
+        }
+    }
+
+    switch (new_store->type[new_id]) {
+    case ELEMENT_INPUT:
+        if (!str_eq(old_element->input.placeholder, new_element->input.placeholder)) {
+            emit_set_property(node, "placeholder", new_element->input.placeholder);
+        }
+        break;
+    case ELEMENT_CANVAS:
+        if (!str_eq(old_element->canvas.id, new_element->canvas.id)) {
+            emit_set_property(node, "id", new_element->canvas.id);
+        }
+        if (old_element->canvas.width != new_element->canvas.width) {
+            emit_set_property(node, "width", arena_sprintf(&r_arena, "%zu", new_element->canvas.width));
+        }
+        if (old_element->canvas.height != new_element->canvas.height) {
+            emit_set_property(node, "height", arena_sprintf(&r_arena, "%zu", new_element->canvas.height));
+        }
+        break;
+    case ELEMENT_VIRTUAL_LIST: {
+        VirtualListElement* a = &old_element->virtual_list;
+        VirtualListElement* b = &new_element->virtual_list;
+        if (a->count != b->count || a->row_height != b->row_height || a->first != b->first || a->last != b->last) {
+            emit_u8(RENDER_OP_SET_WINDOW);
+            emit_u32(node);
+            emit_window(b);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    diff_attributes(node, old_id, new_id);
+
+    if (!str_eq(old_store->text[old_id], new_store->text[new_id])) {
+        emit_set_text(node, new_store->text[new_id]);
+    }
+
+    diff_children(node, old_id, new_id);
+}
+
+// Diffs the roots of both stores, the previous one is empty before the first render
+void diff_root()
+{
+    NodeStore* old_store = r_prev_nodes;
+    NodeStore* new_store = r_nodes;
+    bool has_old_root = old_store->count > 0;
+    if (has_old_root && old_store->element[0] == new_store->element[0]) {
+        return;
+    }
+
+    bool reuse_new_root = node_shared_with_prev_frame(new_store, 0);
+    if (has_old_root && !reuse_new_root && !node_shared_with_prev_frame(old_store, 0) && nodes_compatible(0, 0)) {
+        diff_node(0, 0);
+        return;
+    }
+
+    if (has_old_root && !node_shared_with_prev_frame(old_store, 0)) {
+        emit_remove(old_store->node[0]);
+    }
+
+    if (!reuse_new_root) {
+        create_node(0);
+    }
+    emit_move(ROOT_NODE, new_store->node[0], 0);
+}
+
+Element* render_component();
+void drain_events();
+void drop_events();
+
+[[clang::export_name("init_component")]]
+void init_component();
+
+[[clang::export_name("render_component")]]
+const RenderOutput* render_component_internal() {
+    // Queued events refer to the elements of the previous render, they are handled before it is replaced
+    drain_events();
+
+    begin_frame();
+    r_virtual_list_count = 0;
+
+    r_root = render_component();
+    ASSERT(r_root != NULL);
+
+    arena_reset(&r_diff_arena);
+    r_output.commands.count = 0;
+    r_output.strings.count = 0;
+    r_output.string_count = 0;
+    node_store_build(r_root);
+    diff_root();
+
+    return &r_output;
+}
+
+// Forgets everything the host was told so far, the next render creates the whole tree again for a
+// host that starts without nodes. The state of the application itself is kept.
+[[clang::export_name("reset_render_state")]]
+void reset_render_state()
+{
+    r_root = NULL;
+    r_prev_root = NULL;
+    r_elements.count = 0;
+    r_prev_elements.count = 0;
+    r_nodes->count = 0;
+    r_prev_nodes->count = 0;
+
+    // Memoized subtrees refer to nodes of the old host, they are rendered again
+    for (size_t i = 0; i < r_memo_count; i++) {
+        MemoSlot* slot = &r_memo_slots[i];
+        slot->root = NULL;
+        slot->frame = 0;
+        slot->prev_frame = 0;
+        slot->shared_frame = 0;
+    }
+
+    for (size_t id = 1; id <= r_interned_count; id++) {
+        r_interned[id].sent = false;
+    }
+
+    for (size_t i = 0; i < VIRTUAL_LIST_CAPACITY; i++) {
+        r_virtual_lists[i] = (VirtualListState) {0};
+    }
+
+    drop_events();
+
+    r_dirty = false;
+    r_render_requested = false;
+}
+
+// Calls the handlers of element for the event, without bubbling, the host does that
+void dispatch_event(Element* element, const Event* event)
+{
+    bool changed = false;
+
+    // The host input shows what was typed now instead of the value rendered last
+    bool edited = event->type == EVENT_INPUT || event->type == EVENT_CHANGE;
+    if (edited && element->type == ELEMENT_INPUT && element->text && event->value) {
+        r_nodes->text[element->id] = arena_strdup(&r_arena, event->value);
+    }
+
+    if (event->type == EVENT_CLICK && element->type == ELEMENT_BUTTON && element->button.on_click) {
+        changed |= element->button.on_click(element->button.on_click_args);
+    }
+    if (event->type == EVENT_CHANGE && element->type == ELEMENT_INPUT && element->input.on_change) {
+        changed |= element->input.on_change(event->value);
+    }
+
+    if (element->listeners) {
+        for (size_t i = 0; i < element->listeners->count; i++) {
+            Listener* listener = &element->listeners->items[i];
+            if (listener->type == event->type) {
+                changed |= listener->handler(event, listener->args);
+            }
+        }
+    }
+
+    if (changed) {
+        sandor_invalidate();
+    }
+}
+
+[[clang::export_name("invoke_on_event")]]
+void invoke_on_event(size_t element_index, EventType type, const char* value, int32_t x, int32_t y, uint32_t modifiers) {
+    Element* element = find_element(element_index);
+    ASSERT(element != NULL);
+
+    Event event = {
+        .type = type,
+        .value = value,
+        .x = x,
+        .y = y,
+        .modifiers = modifiers
+    };
+    dispatch_event(element, &event);
+
+    flush_invalidations();
+}
+
+// The host queues events in linear memory instead of calling in for each of them, one record per
+// element on the way up from the target, innermost first. The queue is drained by the next render,
+// or by invoke_queued_events once per frame when no render is due. The host coalesces consecutive
+// pointer moves, wheel and input events of the same targets into one.
+#define EVENT_QUEUE_CAPACITY 256
+#define EVENT_TEXT_CAPACITY 4096
+
+typedef struct {
+    uint32_t type;
+    uint32_t element_index;
+    int32_t x;
+    int32_t y;
+    int32_t delta_x;
+    int32_t delta_y;
+    uint32_t modifiers;
+    // Offset of the NUL terminated value in the text of the queue + 1, 0 for events without a value
+    uint32_t value;
+} QueuedEvent;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    QueuedEvent* items;
+    size_t text_size;
+    size_t text_capacity;
+    char* text;
+} EventQueue;
+
+Arena event_queue_arena = {0};
+Arena event_text_arena = {0};
+EventQueue r_event_queue = {0};
+// Next record to dispatch while draining
+size_t r_event_queue_next = 0;
+
+// Returns the queue, with room for at least records more records and text_size more bytes of text
+[[clang::export_name("reserve_events")]]
+EventQueue* reserve_events(size_t records, size_t text_size)
+{
+    EventQueue* queue = &r_event_queue;
+
+    if (queue->count + records > queue->capacity) {
+        size_t capacity = queue->capacity > 0 ? queue->capacity : EVENT_QUEUE_CAPACITY;
+        while (capacity < queue->count + records) {
+            capacity *= 2;
+        }
+        queue->items = arena_realloc(&event_queue_arena, queue->items, queue->capacity * sizeof(QueuedEvent), capacity * sizeof(QueuedEvent));
+        queue->capacity = capacity;
+    }
+
+    if (queue->text_size + text_size > queue->text_capacity) {
+        size_t capacity = queue->text_capacity > 0 ? queue->text_capacity : EVENT_TEXT_CAPACITY;
+        while (capacity < queue->text_size + text_size) {
+            capacity *= 2;
+        }
+        queue->text = arena_realloc(&event_text_arena, queue->text, queue->text_capacity, capacity);
+        queue->text_capacity = capacity;
+    }
+
+    return queue;
+}
+
+void drop_events()
+{
+    r_event_queue.count = 0;
+    r_event_queue.text_size = 0;
+    r_event_queue_next = 0;
+}
+
+// Dispatches the queued events in order. A handler that renders synchronously drains the rest of the
+// queue inside that render, before the element indices of the records change.
+void drain_events()
+{
+    while (r_event_queue_next < r_event_queue.count) {
+        QueuedEvent* queued = &r_event_queue.items[r_event_queue_next++];
+        Element* element = find_element(queued->element_index);
+        ASSERT(element != NULL);
+
+        Event event = {
+            .type = queued->type,
+            .value = queued->value > 0 ? r_event_queue.text + queued->value - 1 : NULL,
+            .x = queued->x,
+            .y = queued->y,
+            .delta_x = queued->delta_x,
+            .delta_y = queued->delta_y,
+            .modifiers = queued->modifiers
+        };
+        dispatch_event(element, &event);
+    }
+
+    drop_events();
+}
+
+[[clang::export_name("invoke_queued_events")]]
+void invoke_queued_events()
+{
+    drain_events();
+
+    flush_invalidations();
+}
+
+[[clang::export_name("invoke_on_click")]]
+void invoke_on_click(size_t element_index) {
+    invoke_on_event(element_index, EVENT_CLICK, NULL, 0, 0, 0);
+}
+
+[[clang::export_name("invoke_on_change")]]
+void invoke_on_change(size_t element_index, const char* value) {
+    invoke_on_event(element_index, EVENT_CHANGE, value, 0, 0, 0);
+}
+
+// Only renders again when the scroll moved the window of rows
+[[clang::export_name("invoke_on_scroll")]]
+void invoke_on_scroll(size_t element_index, size_t scroll_top, size_t viewport_height) {
+    Element* element = find_element(element_index);
+    ASSERT(element != NULL && element->type == ELEMENT_VIRTUAL_LIST);
+
+    VirtualListElement* virtual_list = &element->virtual_list;
+    VirtualListState* state = &r_virtual_lists[virtual_list->state];
+    state->scroll_top = scroll_top;
+    state->viewport_height = viewport_height;
+
+    size_t first, last;
+    virtual_list_window(state, virtual_list->count, virtual_list->row_height, &first, &last);
+    if (first != virtual_list->first || last != virtual_list->last) {
+        sandor_invalidate();
+    }
+
+    flush_invalidations();
+}
+
+// Animation callbacks run on every display frame with the time since the last one, unless they are
+// paced with pace_animation_frame(). dt is clamped either way, so an animation does not jump ahead
+// after the tab was in the background. Callbacks are paused while none of the canvases they present
+// is visible, because it scrolled out of view or the tab is hidden.
+#define ANIMATION_MAX_DT 0.1f
+#define ANIMATION_MAX_STEPS 4
+#define ANIMATION_PACING_CAPACITY 32
+
+typedef struct {
+    // Calls per second, 0 calls the callback on every display frame
+    float rate;
+    // If set, dt is always fixed_step and the callback runs as many times as the elapsed time needs
+    float fixed_step;
+    // Most fixed steps run in one call, time beyond them is dropped. ANIMATION_MAX_STEPS if 0.
+    uint32_t max_steps;
+    // Longest display frame counted. ANIMATION_MAX_DT if 0.
+    float max_dt;
+    // Calls per second while the callback is not visible, 0 pauses it
+    float hidden_rate;
+    // Called with the seconds the callback was paused for before it runs again, e.g. to advance a
+    // simulation analytically. Without it, the callback continues as if no time had passed.
+    void (*on_resume)(float paused);
+} AnimationPacing;
+
+typedef struct {
+    void (*callback)(float dt);
+    AnimationPacing pacing;
+    // Time counted since the callback last ran, or not covered by its fixed steps
+    float pending;
+    // Time since the callback was last due, it keeps the rate when frames do not line up with it
+    float phase;
+    // Time the callback has been paused for, unclamped
+    float paused;
+} PacedAnimation;
+
+PacedAnimation r_paced_animations[ANIMATION_PACING_CAPACITY] = {0};
+size_t r_paced_animation_count = 0;
+
+// Measured by the host before every display frame with animation callbacks
+typedef struct {
+    // Seconds since the previous display frame
+    float frame_interval;
+    // Seconds all animation callbacks took in the previous display frame, the budget is the interval
+    float frame_work;
+    uint32_t frames;
+    // Fixed steps dropped so far because a callback fell more than max_steps behind
+    uint32_t dropped_steps;
+} FrameStats;
+
+FrameStats r_frame_stats = {0};
+
+[[clang::export_name("get_frame_stats")]]
+FrameStats* get_frame_stats() {
+    return &r_frame_stats;
+}
+
+PacedAnimation* find_paced_animation(void (*callback)(float dt))
+{
+    for (size_t i = 0; i < r_paced_animation_count; i++) {
+        if (r_paced_animations[i].callback == callback) {
+            return &r_paced_animations[i];
+        }
+    }
+    return NULL;
+}
+
+// The pacing belongs to callback, it applies whenever it is registered with
+// platform_on_animation_frame(). Pacing it again replaces it and starts counting from scratch.
+void pace_animation_frame(void (*callback)(float dt), AnimationPacing pacing)
+{
+    ASSERT(callback != NULL);
+    ASSERT(pacing.rate >= 0 && pacing.fixed_step >= 0 && pacing.max_dt >= 0 && pacing.hidden_rate >= 0);
+
+    PacedAnimation* paced = find_paced_animation(callback);
+    if (paced == NULL) {
+        ASSERT(r_paced_animation_count < ANIMATION_PACING_CAPACITY);
+        paced = &r_paced_animations[r_paced_animation_count++];
+    }
+
+    if (pacing.max_steps == 0) pacing.max_steps = ANIMATION_MAX_STEPS;
+    if (pacing.max_dt == 0) pacing.max_dt = ANIMATION_MAX_DT;
+    *paced = (PacedAnimation) { .callback = callback, .pacing = pacing };
+}
+
+void run_paced_animation(PacedAnimation* paced, float dt, bool visible)
+{
+    AnimationPacing pacing = paced->pacing;
+    if (!visible && pacing.hidden_rate == 0) {
+        paced->paused += dt;
+        return;
+    }
+
+    if (paced->paused > 0) {
+        float paused = paced->paused;
+        *paced = (PacedAnimation) { .callback = paced->callback, .pacing = pacing };
+        if (pacing.on_resume != NULL) pacing.on_resume(paused);
+        dt = 0;
+    }
+
+    if (dt > pacing.max_dt) dt = pacing.max_dt;
+    paced->pending += dt;
+
+    // The frame closest to the due time runs the callback, a callback that fell further behind does
+    // not catch up
+    float rate = visible ? pacing.rate : pacing.hidden_rate;
+    if (rate > 0) {
+        float interval = 1.0f/rate;
+        paced->phase += dt;
+        if (paced->phase + dt/2 < interval) return;
+        paced->phase -= interval;
+        if (paced->phase >= interval) paced->phase = 0;
+    }
+
+    if (pacing.fixed_step == 0) {
+        float elapsed = paced->pending;
+        paced->pending = 0;
+        paced->callback(elapsed);
+        return;
+    }
+
+    uint32_t steps = (uint32_t)(paced->pending/pacing.fixed_step);
+    paced->pending -= steps*pacing.fixed_step;
+    if (steps > pacing.max_steps) {
+        r_frame_stats.dropped_steps += steps - pacing.max_steps;
+        steps = pacing.max_steps;
+    }
+    for (uint32_t i = 0; i < steps; i++) {
+        paced->callback(pacing.fixed_step);
+    }
+}
+
+// visible tells whether the callback was visible for all of dt
+[[clang::export_name("invoke_animation_frame_callback")]]
+void invoke_animation_frame_callback(void (*callback)(float dt), float dt, bool visible) {
+    ASSERT(callback != NULL);
+
+    PacedAnimation* paced = find_paced_animation(callback);
+    if (paced != NULL) {
+        run_paced_animation(paced, dt, visible);
+    } else if (visible) {
+        callback(dt < ANIMATION_MAX_DT ? dt : ANIMATION_MAX_DT);
+    }
+
+    flush_invalidations();
 }
 
-[[clang::export_name("get_layout_word_size")]]
-size_t get_layout_word_size() {
-    return sizeof(size_t);
+// End of the memory in use: data, stack and every arena region lie below it. The host snapshots
+// memory up to here, the bump pointer itself is part of the snapshot.
+[[clang::export_name("get_heap_end")]]
+void* get_heap_end() {
+    return bump_pointer;
 }
 
 #endif // SANDOR_H
\ No newline at end of file
@@ -398,6 +398,22 @@ static Olivec_Font olivec_default_font = {
     .height = OLIVEC_DEFAULT_FONT_HEIGHT,
 };
 
+#ifndef OLIVEC_DIRTY_CAPACITY
+#define OLIVEC_DIRTY_CAPACITY 16
+#endif
+
+typedef struct {
+    int x, y, w, h;
+} Olivec_Rect;
+
+// Regions touched by drawing, relative to the canvas tracking was started on. Once it is full, new
+// regions are merged into the rect that grows the least.
+typedef struct {
+    uint32_t *origin;
+    size_t count;
+    Olivec_Rect rects[OLIVEC_DIRTY_CAPACITY];
+} Olivec_Dirty;
+
 // WARNING! Always initialize your Canvas with a color that has Non-Zero Alpha Channel!
 // A lot of functions use `olivec_blend_color()` function to blend with the Background
 // which preserves the original Alpha of the Background. So you may easily end up with
@@ -407,6 +423,8 @@ typedef struct {
     size_t width;
     size_t height;
     size_t stride;
+    // Optional, NULL unless tracking was started with olivec_track_dirty(). Subcanvases share it.
+    Olivec_Dirty *dirty;
 } Olivec_Canvas;
 
 #define OLIVEC_CANVAS_NULL ((Olivec_Canvas) {0})
@@ -414,6 +432,10 @@ typedef struct {
 
 OLIVECDEF Olivec_Canvas olivec_canvas(uint32_t *pixels, size_t width, size_t height, size_t stride);
 OLIVECDEF Olivec_Canvas olivec_subcanvas(Olivec_Canvas oc, int x, int y, int w, int h);
+OLIVECDEF Olivec_Canvas olivec_track_dirty(Olivec_Canvas oc, Olivec_Dirty *dirty);
+// For pixels written directly with OLIVEC_PIXEL, the drawing functions mark what they touch themselves
+OLIVECDEF void olivec_dirty_mark(Olivec_Canvas oc, int x, int y, int w, int h);
+OLIVECDEF void olivec_dirty_clear(Olivec_Dirty *dirty);
 OLIVECDEF bool olivec_in_bounds(Olivec_Canvas oc, int x, int y);
 OLIVECDEF void olivec_blend_color(uint32_t *c1, uint32_t c2);
 OLIVECDEF void olivec_fill(Olivec_Canvas oc, uint32_t color);
@@ -524,6 +546,79 @@ OLIVECDEF Olivec_Canvas olivec_subcanvas(Olivec_Canvas oc, int x, int y, int w,
     return oc;
 }
 
+OLIVECDEF Olivec_Canvas olivec_track_dirty(Olivec_Canvas oc, Olivec_Dirty *dirty)
+{
+    if (dirty->origin != oc.pixels) {
+        dirty->origin = oc.pixels;
+        dirty->count = 0;
+    }
+    oc.dirty = dirty;
+    return oc;
+}
+
+OLIVECDEF void olivec_dirty_clear(Olivec_Dirty *dirty)
+{
+    dirty->count = 0;
+}
+
+// Adds the region x1..x2, y1..y2 of oc, already clamped to oc
+OLIVECDEF void olivec_dirty_add(Olivec_Canvas oc, int x1, int y1, int x2, int y2)
+{
+    Olivec_Dirty *dirty = oc.dirty;
+    if (dirty == NULL) return;
+
+    // Subcanvases are translated to the canvas tracking was started on
+    size_t offset = oc.pixels - dirty->origin;
+    Olivec_Rect nr = {
+        .x = x1 + offset%oc.stride,
+        .y = y1 + offset/oc.stride,
+        .w = x2 - x1 + 1,
+        .h = y2 - y1 + 1,
+    };
+
+    for (size_t i = 0; i < dirty->count; ++i) {
+        Olivec_Rect *dr = &dirty->rects[i];
+        // Already covered
+        if (dr->x <= nr.x && dr->y <= nr.y && nr.x + nr.w <= dr->x + dr->w && nr.y + nr.h <= dr->y + dr->h) return;
+        // Covers an earlier one, which is dropped
+        if (nr.x <= dr->x && nr.y <= dr->y && dr->x + dr->w <= nr.x + nr.w && dr->y + dr->h <= nr.y + nr.h) {
+            *dr = dirty->rects[--dirty->count];
+            --i;
+        }
+    }
+
+    if (dirty->count < OLIVEC_DIRTY_CAPACITY) {
+        dirty->rects[dirty->count++] = nr;
+        return;
+    }
+
+    size_t best = 0;
+    int best_growth = 0;
+    Olivec_Rect best_union = {0};
+    for (size_t i = 0; i < dirty->count; ++i) {
+        Olivec_Rect dr = dirty->rects[i];
+        int ux1 = dr.x < nr.x ? dr.x : nr.x;
+        int uy1 = dr.y < nr.y ? dr.y : nr.y;
+        int ux2 = dr.x + dr.w > nr.x + nr.w ? dr.x + dr.w : nr.x + nr.w;
+        int uy2 = dr.y + dr.h > nr.y + nr.h ? dr.y + dr.h : nr.y + nr.h;
+        int growth = (ux2 - ux1)*(uy2 - uy1) - dr.w*dr.h;
+        if (i == 0 || growth < best_growth) {
+            best = i;
+            best_growth = growth;
+            best_union = (Olivec_Rect) { .x = ux1, .y = uy1, .w = ux2 - ux1, .h = uy2 - uy1 };
+        }
+    }
+    dirty->rects[best] = best_union;
+}
+
+OLIVECDEF void olivec_dirty_mark(Olivec_Canvas oc, int x, int y, int w, int h)
+{
+    if (oc.dirty == NULL) return;
+    Olivec_Normalized_Rect nr = {0};
+    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+    olivec_dirty_add(oc, nr.x1, nr.y1, nr.x2, nr.y2);
+}
+
 // TODO: custom pixel formats
 // Maybe we can store pixel format info in Olivec_Canvas
 #define OLIVEC_RED(color)   (((color)&0x000000FF)>>(8*0))
@@ -553,6 +648,8 @@ OLIVECDEF void olivec_blend_color(uint32_t *c1, uint32_t c2)
 
 OLIVECDEF void olivec_fill(Olivec_Canvas oc, uint32_t color)
 {
+    if (oc.width == 0 || oc.height == 0) return;
+    olivec_dirty_add(oc, 0, 0, oc.width - 1, oc.height - 1);
     for (size_t y = 0; y < oc.height; ++y) {
         for (size_t x = 0; x < oc.width; ++x) {
             OLIVEC_PIXEL(oc, x, y) = color;
@@ -564,6 +661,7 @@ OLIVECDEF void olivec_rect(Olivec_Canvas oc, int x, int y, int w, int h, uint32_
 {
     Olivec_Normalized_Rect nr = {0};
     if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+    olivec_dirty_add(oc, nr.x1, nr.y1, nr.x2, nr.y2);
     for (int x = nr.x1; x <= nr.x2; ++x) {
         for (int y = nr.y1; y <= nr.y2; ++y) {
             olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
@@ -595,6 +693,7 @@ OLIVECDEF void olivec_ellipse(Olivec_Canvas oc, int cx, int cy, int rx, int ry,
     int rx1 = rx + OLIVEC_SIGN(int, rx);
     int ry1 = ry + OLIVEC_SIGN(int, ry);
     if (!olivec_normalize_rect(cx - rx1, cy - ry1, 2*rx1, 2*ry1, oc.width, oc.height, &nr)) return;
+    olivec_dirty_add(oc, nr.x1, nr.y1, nr.x2, nr.y2);
 
     for (int y = nr.y1; y <= nr.y2; ++y) {
         for (int x = nr.x1; x <= nr.x2; ++x) {
@@ -614,6 +713,7 @@ OLIVECDEF void olivec_circle(Olivec_Canvas oc, int cx, int cy, int r, uint32_t c
     Olivec_Normalized_Rect nr = {0};
     int r1 = r + OLIVEC_SIGN(int, r);
     if (!olivec_normalize_rect(cx - r1, cy - r1, 2*r1, 2*r1, oc.width, oc.height, &nr)) return;
+    olivec_dirty_add(oc, nr.x1, nr.y1, nr.x2, nr.y2);
 
     for (int y = nr.y1; y <= nr.y2; ++y) {
         for (int x = nr.x1; x <= nr.x2; ++x) {
@@ -645,6 +745,7 @@ OLIVECDEF void olivec_line(Olivec_Canvas oc, int x1, int y1, int x2, int y2, uin
 {
     int dx = x2 - x1;
     int dy = y2 - y1;
+    olivec_dirty_mark(oc, x1, y1, dx + OLIVEC_SIGN(int, dx) + (dx == 0), dy + OLIVEC_SIGN(int, dy) + (dy == 0));
 
     // If both of the differences are 0 there will be a division by 0 below.
     if (dx == 0 && dy == 0) {
@@ -786,6 +887,7 @@ OLIVECDEF void olivec_triangle3c(Olivec_Canvas oc, int x1, int y1, int x2, int y
 {
     int lx, hx, ly, hy;
     if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
+        olivec_dirty_add(oc, lx, ly, hx, hy);
         for (int y = ly; y <= hy; ++y) {
             for (int x = lx; x <= hx; ++x) {
                 int u1, u2, det;
@@ -801,6 +903,7 @@ OLIVECDEF void olivec_triangle3z(Olivec_Canvas oc, int x1, int y1, int x2, int y
 {
     int lx, hx, ly, hy;
     if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
+        olivec_dirty_add(oc, lx, ly, hx, hy);
         for (int y = ly; y <= hy; ++y) {
             for (int x = lx; x <= hx; ++x) {
                 int u1, u2, det;
@@ -817,6 +920,7 @@ OLIVECDEF void olivec_triangle3uv(Olivec_Canvas oc, int x1, int y1, int x2, int
 {
     int lx, hx, ly, hy;
     if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
+        olivec_dirty_add(oc, lx, ly, hx, hy);
         for (int y = ly; y <= hy; ++y) {
             for (int x = lx; x <= hx; ++x) {
                 int u1, u2, det;
@@ -844,6 +948,7 @@ OLIVECDEF void olivec_triangle3uv_bilinear(Olivec_Canvas oc, int x1, int y1, int
 {
     int lx, hx, ly, hy;
     if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
+        olivec_dirty_add(oc, lx, ly, hx, hy);
         for (int y = ly; y <= hy; ++y) {
             for (int x = lx; x <= hx; ++x) {
                 int u1, u2, det;
@@ -877,6 +982,7 @@ OLIVECDEF void olivec_triangle(Olivec_Canvas oc, int x1, int y1, int x2, int y2,
 {
     int lx, hx, ly, hy;
     if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
+        olivec_dirty_add(oc, lx, ly, hx, hy);
         for (int y = ly; y <= hy; ++y) {
             for (int x = lx; x <= hx; ++x) {
                 int u1, u2, det;
@@ -890,6 +996,12 @@ OLIVECDEF void olivec_triangle(Olivec_Canvas oc, int x1, int y1, int x2, int y2,
 
 OLIVECDEF void olivec_text(Olivec_Canvas oc, const char *text, int tx, int ty, Olivec_Font font, size_t glyph_size, uint32_t color)
 {
+    // The whole line of text is marked once instead of every glyph pixel
+    size_t n = 0;
+    while (text[n]) ++n;
+    olivec_dirty_mark(oc, tx, ty, n*font.width*glyph_size, font.height*glyph_size);
+    oc.dirty = NULL;
+
     for (size_t i = 0; *text; ++i, ++text) {
         int gx = tx + i*font.width*glyph_size;
         int gy = ty;
@@ -915,6 +1027,7 @@ OLIVECDEF void olivec_sprite_blend(Olivec_Canvas oc, int x, int y, int w, int h,
 
     Olivec_Normalized_Rect nr = {0};
     if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+    olivec_dirty_add(oc, nr.x1, nr.y1, nr.x2, nr.y2);
 
     int xa = nr.ox1;
     if (w < 0) xa = nr.ox2;
@@ -938,6 +1051,7 @@ OLIVECDEF void olivec_sprite_copy(Olivec_Canvas oc, int x, int y, int w, int h,
     // Similar to how SDL_RenderCopyEx does that
     Olivec_Normalized_Rect nr = {0};
     if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+    olivec_dirty_add(oc, nr.x1, nr.y1, nr.x2, nr.y2);
 
     int xa = nr.ox1;
     if (w < 0) xa = nr.ox2;
@@ -1002,6 +1116,7 @@ OLIVECDEF void olivec_sprite_copy_bilinear(Olivec_Canvas oc, int x, int y, int w
 
     Olivec_Normalized_Rect nr = {0};
     if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+    olivec_dirty_add(oc, nr.x1, nr.y1, nr.x2, nr.y2);
 
     for (int y = nr.y1; y <= nr.y2; ++y) {
         for (int x = nr.x1; x <= nr.x2; ++x) {